@@ -0,0 +1,69 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+namespace WebChannelPP
+{
+namespace Bench
+{
+
+/// @brief Keeps the compiler from optimizing away the computation of @p value
+template<class T>
+inline void keep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/// @brief Runs @p body with 0 ... @p iterations - 1 and returns the time per iteration in
+///        nanoseconds, the best of @p rounds runs
+template<class Body>
+double ns_per_op(std::size_t iterations, Body &&body, int rounds = 5)
+{
+    double best = 0;
+    for (int round = 0; round < rounds; ++round) {
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iterations; ++i) {
+            body(i);
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        const double ns = std::chrono::duration<double, std::nano>(elapsed).count() / double(iterations);
+        best = round == 0 ? ns : std::min(best, ns);
+    }
+    return best;
+}
+
+/// @brief Returns the duration of a single run of @p body in milliseconds, the best of @p rounds runs
+template<class Body>
+double ms_per_run(Body &&body, int rounds = 5)
+{
+    double best = 0;
+    for (int round = 0; round < rounds; ++round) {
+        const auto start = std::chrono::steady_clock::now();
+        body();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        const double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+        best = round == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+inline void report(const char *name, double value, const char *unit)
+{
+    std::printf("%-48s %12.1f %s\n", name, value, unit);
+}
+
+}
+}
+
+#endif // BENCH_UTIL_H
@@ -0,0 +1,101 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Newline scanning: the implementations of find_byte() against a plain loop, and the
+// resumed scan of ReceiveBuffer for frames that arrive in many reads
+
+#include <webchannelpp/byte_search.h>
+#include <webchannelpp/receive_buffer.h>
+
+#include <string>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+static const char *find_loop(const char *first, const char *last, char value)
+{
+    for (; first != last; ++first) {
+        if (*first == value) {
+            return first;
+        }
+    }
+    return last;
+}
+
+static void bench_scan(const char *name, detail::find_byte_fn impl, std::size_t lineSize)
+{
+    std::string data;
+    while (data.size() < 1024 * 1024) {
+        data.append(lineSize - 1, 'a');
+        data.push_back('\n');
+    }
+
+    std::size_t lines = 0;
+    const double ms = Bench::ms_per_run([&]() {
+        const char *pos = data.data();
+        const char *last = pos + data.size();
+        while ((pos = impl(pos, last, '\n')) != last) {
+            ++lines;
+            ++pos;
+        }
+    }, 20);
+    Bench::keep(lines);
+
+    char label[96];
+    std::snprintf(label, sizeof(label), "%s, %zu B lines", name, lineSize);
+    Bench::report(label, double(data.size()) / ms * 1e-6, "GB/s");
+}
+
+static void bench_resumed(std::size_t frameSize, std::size_t readSize)
+{
+    const std::string frame = std::string(frameSize - 1, 'a') + "\n";
+
+    // without resuming, every read rescans the whole incomplete frame
+    std::size_t found = 0;
+    const double rescanMs = Bench::ms_per_run([&]() {
+        std::string buffer;
+        for (std::size_t pos = 0; pos < frame.size(); pos += readSize) {
+            buffer.append(frame, pos, readSize);
+            found += find_byte(buffer.data(), buffer.data() + buffer.size(), '\n') - buffer.data();
+        }
+    });
+
+    const double resumeMs = Bench::ms_per_run([&]() {
+        ReceiveBuffer buffer;
+        for (std::size_t pos = 0; pos < frame.size(); pos += readSize) {
+            buffer.append(frame.data() + pos, std::min(readSize, frame.size() - pos));
+            FrameView view;
+            found += buffer.next_line(view);
+        }
+    });
+    Bench::keep(found);
+
+    char label[96];
+    std::snprintf(label, sizeof(label), "%zu KiB frame in %zu B reads, rescan", frameSize / 1024, readSize);
+    Bench::report(label, rescanMs * 1e3, "us");
+    std::snprintf(label, sizeof(label), "%zu KiB frame in %zu B reads, resumed", frameSize / 1024, readSize);
+    Bench::report(label, resumeMs * 1e3, "us");
+}
+
+int main()
+{
+    for (std::size_t lineSize : { 64, 1024 }) {
+        bench_scan("byte loop", find_loop, lineSize);
+        bench_scan("memchr", detail::find_byte_scalar, lineSize);
+#ifdef WEBCHANNELPP_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse2")) {
+            bench_scan("sse2", detail::find_byte_sse2, lineSize);
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            bench_scan("avx2", detail::find_byte_avx2, lineSize);
+        }
+#endif
+    }
+
+    bench_resumed(1024 * 1024, 4096);
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Cost of tracking requests with 100k of them in flight, in the callback table and in the
+// std::map the channel used before
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/loopback_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+typedef std::function<void(ExecStatus, const nlohmann::json &)> Callback;
+
+static const std::size_t inFlight = 100000;
+
+static void bench_table()
+{
+    CallbackTable<Callback> table;
+    long sum = 0;
+    std::vector<unsigned int> ids(inFlight);
+
+    // completes the requests in the order they were made, like a host answering in turn
+    Bench::report("callback table, insert + complete", Bench::ms_per_run([&]() {
+        for (std::size_t i = 0; i < inFlight; ++i) {
+            ids[i] = table.insert([&sum, i](ExecStatus, const nlohmann::json &) { sum += long(i); });
+        }
+        Callback callback;
+        for (std::size_t i = 0; i < inFlight; ++i) {
+            if (table.take(ids[i], callback)) {
+                callback(ExecStatus::Ok, nullptr);
+            }
+        }
+    }) * 1e6 / inFlight, "ns/request");
+    Bench::keep(sum);
+}
+
+static void bench_map()
+{
+    std::map<unsigned int, Callback> map;
+    unsigned int nextId = 0;
+    long sum = 0;
+    std::vector<unsigned int> ids(inFlight);
+
+    Bench::report("std::map, insert + complete", Bench::ms_per_run([&]() {
+        for (std::size_t i = 0; i < inFlight; ++i) {
+            ids[i] = nextId++;
+            map[ids[i]] = [&sum, i](ExecStatus, const nlohmann::json &) { sum += long(i); };
+        }
+        for (std::size_t i = 0; i < inFlight; ++i) {
+            map[ids[i]](ExecStatus::Ok, nullptr);
+            map.erase(ids[i]);
+        }
+    }) * 1e6 / inFlight, "ns/request");
+    Bench::keep(sum);
+}
+
+static void bench_channel()
+{
+    LoopbackPair pair;
+    MockHost host(pair.host);
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+    QObject *object = channel.object("object0");
+
+    long sum = 0;
+    Bench::report("channel, 100k invokes in flight", Bench::ms_per_run([&]() {
+        for (std::size_t i = 0; i < inFlight; ++i) {
+            object->invoke("method0", int(i), [&](int r) { sum += r; });
+        }
+        pair.run();
+    }) * 1e6 / inFlight, "ns/request");
+    Bench::keep(sum);
+}
+
+int main()
+{
+    bench_table();
+    bench_map();
+    bench_channel();
+}
@@ -0,0 +1,61 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Throughput of newline-delimited against length-prefixed framing over loopback TCP
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/asio_transport.h>
+
+#include <memory>
+#include <string>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+template<class Transport>
+static void bench(const char *name, std::size_t payloadSize, std::size_t count)
+{
+    asio::io_context io;
+    asio::ip::tcp::socket clientSocket(io);
+    asio::ip::tcp::socket hostSocket(io);
+    asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    clientSocket.connect(acceptor.local_endpoint());
+    acceptor.accept(hostSocket);
+
+    Transport client(clientSocket);
+    Transport host(hostSocket);
+
+    // payloads are passed on as text, so only the framing is measured
+    std::size_t received = 0;
+    host.register_serialized_message_handler([&](const char *, std::size_t) { ++received; });
+
+    const std::string payload = "\"" + std::string(payloadSize - 2, 'x') + "\"";
+    const double ms = Bench::ms_per_run([&]() {
+        received = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            std::string message = client.acquire_buffer();
+            message.assign(payload);
+            client.send_serialized(std::move(message));
+        }
+        while (received < count) {
+            io.run_one();
+        }
+    }, 3);
+
+    char label[96];
+    std::snprintf(label, sizeof(label), "%s, %zu B messages", name, payloadSize);
+    Bench::report(label, double(count) / ms, "k messages/s");
+}
+
+int main()
+{
+    for (std::size_t size : { 100, 10 * 1024, 1024 * 1024 }) {
+        const std::size_t count = size >= 1024 * 1024 ? 200 : 20000;
+        bench<AsioTransport>("newline", size, count);
+        bench<LengthPrefixedAsioTransport>("length-prefixed", size, count);
+    }
+}
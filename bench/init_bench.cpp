@@ -0,0 +1,94 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Time from creating a channel until it is ready and a dozen objects were used, for hosts
+// exporting many objects
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/loopback_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <cstdio>
+#include <string>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+// The Init data of a mock host with @p count objects
+static nlohmann::json init_data(std::size_t count)
+{
+    MockHostConfig config;
+    config.objects = count;
+    config.methods = 8;
+    config.properties = 8;
+    config.signals = 4;
+
+    LoopbackPair pair;
+    MockHost host(pair.host, config);
+    nlohmann::json data;
+    pair.client.register_message_handler([&](const nlohmann::json &message) { data = message["data"]; });
+    pair.client.send(nlohmann::json { { "type", BasicQWebChannelMessageTypes::Init }, { "id", 0 } });
+    pair.run();
+    return data;
+}
+
+enum class Mode
+{
+    Eager,
+    Lazy,
+    Threads,
+};
+
+static void bench(std::size_t count, Mode mode)
+{
+    const nlohmann::json data = init_data(count);
+
+    const double ms = Bench::ms_per_run([&]() {
+        LoopbackPair pair;
+        pair.client.set_serialize(true);
+        pair.host.set_serialize(true);
+
+        // answers the Init request with the data recorded above, so only the client is measured
+        const std::string payload = data.dump();
+        pair.host.register_message_handler([&](const nlohmann::json &request) {
+            if (request["type"] != BasicQWebChannelMessageTypes::Init) {
+                return;
+            }
+            std::string response = "{\"data\":" + payload + ",\"id\":" + request["id"].dump() +
+                                   ",\"type\":" + std::to_string(BasicQWebChannelMessageTypes::Response) + "}";
+            pair.host.send_serialized(std::move(response));
+        });
+
+        bool ready = false;
+        QWebChannel channel(pair.client, [&](QWebChannel *) { ready = true; });
+        channel.set_lazy_objects(mode == Mode::Lazy);
+        channel.set_init_threads(mode == Mode::Threads ? 4 : 1);
+        pair.run();
+
+        // most clients only touch a few objects
+        std::size_t methods = 0;
+        for (std::size_t i = 0; i < 12; ++i) {
+            methods += channel.object("object" + std::to_string(i * count / 12))->methods().size();
+        }
+        Bench::keep(methods);
+        Bench::keep(ready);
+    }, 3);
+
+    static const char *const modes[] = { "eager", "lazy", "4 threads" };
+    char name[64];
+    std::snprintf(name, sizeof(name), "time to ready, %zu objects, %s", count, modes[int(mode)]);
+    Bench::report(name, ms, "ms");
+}
+
+int main()
+{
+    for (std::size_t count : { 100, 1000, 10000 }) {
+        bench(count, Mode::Eager);
+        bench(count, Mode::Lazy);
+        bench(count, Mode::Threads);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Round-trip latency of a method call against the mock host over loopback TCP and over a
+// Unix domain socket
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/asio_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <chrono>
+#include <string>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+template<class Transport, class Socket>
+static void bench(const char *name, asio::io_context &io, Socket &clientSocket, Socket &hostSocket)
+{
+    Transport hostTransport(hostSocket);
+    Transport clientTransport(clientSocket);
+    MockHost host(hostTransport, MockHostConfig());
+
+    bool ready = false;
+    QWebChannel channel(clientTransport, [&](QWebChannel *) { ready = true; });
+    while (!ready) {
+        io.run_one();
+    }
+
+    // one call in flight at a time, so every iteration is a full round trip
+    QObject *object = channel.object("object0");
+    const double ns = Bench::ns_per_op(20000, [&](std::size_t i) {
+        bool answered = false;
+        object->invoke("method0", int(i), [&](int) { answered = true; });
+        while (!answered) {
+            io.run_one();
+        }
+    });
+    Bench::report(name, ns / 1000.0, "us/call");
+}
+
+int main()
+{
+    {
+        asio::io_context io;
+        asio::ip::tcp::socket clientSocket(io);
+        asio::ip::tcp::socket hostSocket(io);
+        asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+        clientSocket.connect(acceptor.local_endpoint());
+        acceptor.accept(hostSocket);
+        clientSocket.set_option(asio::ip::tcp::no_delay(true));
+        hostSocket.set_option(asio::ip::tcp::no_delay(true));
+        bench<AsioTransport>("loopback TCP", io, clientSocket, hostSocket);
+    }
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+    {
+        asio::io_context io;
+        asio::local::stream_protocol::socket clientSocket(io);
+        asio::local::stream_protocol::socket hostSocket(io);
+        asio::local::connect_pair(clientSocket, hostSocket);
+        bench<LocalAsioTransport>("Unix domain socket", io, clientSocket, hostSocket);
+    }
+    {
+        const std::string name = "webchannelpp-bench-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        asio::io_context io;
+        asio::local::stream_protocol::acceptor acceptor(io, abstract_endpoint(name));
+        asio::local::stream_protocol::socket clientSocket(io);
+        asio::local::stream_protocol::socket hostSocket(io);
+        clientSocket.connect(abstract_endpoint(name));
+        acceptor.accept(hostSocket);
+        bench<LocalAsioTransport>("Unix domain socket, abstract namespace", io, clientSocket, hostSocket);
+    }
+#endif
+}
@@ -0,0 +1,54 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Cost of the client stack per request and per signal, without any network
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/loopback_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+static void bench(bool serialize)
+{
+    LoopbackPair pair;
+    pair.client.set_serialize(serialize);
+    pair.host.set_serialize(serialize);
+    MockHost host(pair.host);
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+    QObject *object = channel.object("object0");
+
+    int sum = 0;
+    object->connect("signal0", [&](int value) { sum += value; });
+    pair.run();
+
+    const char *mode = serialize ? "text" : "DOM";
+    char name[64];
+
+    std::snprintf(name, sizeof(name), "invoke round trip (%s)", mode);
+    Bench::report(name, Bench::ns_per_op(20000, [&](std::size_t i) {
+        object->invoke("method0", int(i), [&](int r) { sum += r; });
+        pair.run();
+    }), "ns");
+
+    std::snprintf(name, sizeof(name), "signal delivery (%s)", mode);
+    const nlohmann::json args = nlohmann::json::array({ 1 });
+    Bench::report(name, Bench::ns_per_op(20000, [&](std::size_t) {
+        host.emit_signal(0, 0, args);
+        pair.run();
+    }), "ns");
+
+    Bench::keep(sum);
+}
+
+int main()
+{
+    bench(false);
+    bench(true);
+}
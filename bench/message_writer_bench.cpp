@@ -0,0 +1,91 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Invokes per second with the message writer compared to building and serializing a DOM
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/loopback_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+// serializes every message like the loopback transport, but makes the channel build a DOM first
+class DomLoopbackTransport : public LoopbackTransport
+{
+public:
+    bool accepts_serialized() const override { return false; }
+};
+
+static void bench_encoding()
+{
+    const std::vector<nlohmann::json> args { 42, "argument", 2.5 };
+    const std::string object = "object0";
+
+    MessageWriter writer;
+    std::string buffer;
+    Bench::report("encode invoke, writer", 1e9 / Bench::ns_per_op(200000, [&](std::size_t i) {
+        buffer.clear();
+        writer.write_invoke(buffer, object, 12, args, unsigned(i));
+    }), "invokes/s");
+
+    BasicMessageEncoder<nlohmann::json> encoder;
+    Bench::report("encode invoke, DOM", 1e9 / Bench::ns_per_op(200000, [&](std::size_t i) {
+        buffer.clear();
+        encoder.encode(nlohmann::json {
+            { "type", BasicQWebChannelMessageTypes::InvokeMethod },
+            { "method", 12 },
+            { "args", args },
+            { "object", object },
+            { "id", i },
+        }, buffer);
+    }), "invokes/s");
+}
+
+template<class ClientTransport>
+static void bench_channel(const char *name)
+{
+    ClientTransport client;
+    LoopbackTransport hostTransport;
+    LoopbackTransport::connect(client, hostTransport);
+    client.set_serialize(true);
+    hostTransport.set_serialize(true);
+
+    MockHost host(hostTransport);
+    QWebChannel channel(client, [](QWebChannel *) {});
+    auto run = [&]() {
+        while (hostTransport.process() + client.process() > 0) {
+        }
+    };
+    run();
+    QObject *object = channel.object("object0");
+
+    // a batch of invokes per round trip, like a busy client
+    const std::size_t batch = 64;
+    const std::vector<nlohmann::json> args { 42, "argument", 2.5 };
+    long sum = 0;
+    const double ns = Bench::ns_per_op(500, [&](std::size_t) {
+        for (std::size_t i = 0; i < batch; ++i) {
+            object->invoke("method0", args, std::function<void(const nlohmann::json &)>([&](const nlohmann::json &r) {
+                sum += r.get<int>();
+            }));
+        }
+        run();
+    });
+    Bench::report(name, 1e9 * batch / ns, "invokes/s");
+    Bench::keep(sum);
+}
+
+int main()
+{
+    bench_encoding();
+    bench_channel<LoopbackTransport>("channel round trip, writer");
+    bench_channel<DomLoopbackTransport>("channel round trip, DOM");
+}
@@ -0,0 +1,107 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Routing messages by object name with 10, 1k and 100k objects, in the interned registry and
+// in the std::map the channel used before
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/loopback_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+static std::vector<std::string> names(std::size_t count)
+{
+    std::vector<std::string> result;
+    for (std::size_t i = 0; i < count; ++i) {
+        result.push_back("object" + std::to_string(i));
+    }
+    return result;
+}
+
+static void bench_lookup(std::size_t count)
+{
+    const std::vector<std::string> objects = names(count);
+    // names as they sit in a receive buffer, looked up in a scattered order
+    std::string buffer;
+    std::vector<std::pair<std::size_t, std::size_t>> lookups;
+    for (std::size_t i = 0; i < 4096; ++i) {
+        const std::string &name = objects[(i * 2654435761u) % count];
+        lookups.emplace_back(buffer.size(), name.size());
+        buffer += name;
+    }
+
+    ObjectRegistry<int> registry;
+    std::map<std::string, int> map;
+    for (std::size_t i = 0; i < count; ++i) {
+        registry.set_value(registry.intern(objects[i]), int(i));
+        map[objects[i]] = int(i);
+    }
+
+    char name[64];
+    long sum = 0;
+    std::snprintf(name, sizeof(name), "registry lookup, %zu objects", count);
+    Bench::report(name, Bench::ns_per_op(1000000, [&](std::size_t i) {
+        const auto &lookup = lookups[i % lookups.size()];
+        sum += registry.get(buffer.data() + lookup.first, lookup.second);
+    }), "ns");
+
+    std::snprintf(name, sizeof(name), "std::map lookup, %zu objects", count);
+    Bench::report(name, Bench::ns_per_op(1000000, [&](std::size_t i) {
+        const auto &lookup = lookups[i % lookups.size()];
+        sum += map[std::string(buffer.data() + lookup.first, lookup.second)];
+    }), "ns");
+    Bench::keep(sum);
+}
+
+static void bench_routing(std::size_t count)
+{
+    LoopbackPair pair;
+    pair.client.set_serialize(true);
+    pair.host.set_serialize(true);
+    MockHostConfig config;
+    config.objects = count;
+    config.methods = 1;
+    config.properties = 1;
+    config.signals = 1;
+    MockHost host(pair.host, config);
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+
+    std::vector<std::string> messages;
+    for (std::size_t i = 0; i < 1024; ++i) {
+        messages.push_back(nlohmann::json {
+            { "type", BasicQWebChannelMessageTypes::QSignal },
+            { "object", "object" + std::to_string((i * 2654435761u) % count) },
+            { "signal", 0 },
+            { "args", nlohmann::json::array({ 1 }) },
+        }.dump());
+    }
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "signal routing, %zu objects", count);
+    Bench::report(name, Bench::ns_per_op(100000, [&](std::size_t i) {
+        pair.host.send_serialized(std::string(messages[i % messages.size()]));
+        pair.client.process();
+    }), "ns");
+}
+
+int main()
+{
+    for (std::size_t count : { 10, 1000, 100000 }) {
+        bench_lookup(count);
+    }
+    for (std::size_t count : { 10, 1000, 100000 }) {
+        bench_routing(count);
+    }
+}
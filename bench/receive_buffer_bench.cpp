@@ -0,0 +1,78 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Frames per second split from bursts of newline-delimited messages: ReceiveBuffer against a
+// vector that erases every frame from its front, as AsioTransport used to
+
+#include <webchannelpp/receive_buffer.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+static std::string burst(std::size_t frames, std::size_t frameSize)
+{
+    std::string data;
+    for (std::size_t i = 0; i < frames; ++i) {
+        data.append(frameSize - 1, char('a' + i % 26));
+        data.push_back('\n');
+    }
+    return data;
+}
+
+static void bench(std::size_t frames, std::size_t frameSize, std::size_t readSize)
+{
+    const std::string data = burst(frames, frameSize);
+    std::size_t total = 0;
+
+    const double eraseMs = Bench::ms_per_run([&]() {
+        std::vector<char> buffer;
+        for (std::size_t pos = 0; pos < data.size(); pos += readSize) {
+            const std::size_t n = std::min(readSize, data.size() - pos);
+            buffer.insert(buffer.end(), data.data() + pos, data.data() + pos + n);
+            for (;;) {
+                auto newline = std::find(buffer.begin(), buffer.end(), '\n');
+                if (newline == buffer.end()) {
+                    break;
+                }
+                std::string frame(buffer.begin(), newline);
+                total += frame.size();
+                buffer.erase(buffer.begin(), newline + 1);
+            }
+        }
+    });
+
+    const double cursorMs = Bench::ms_per_run([&]() {
+        ReceiveBuffer buffer;
+        for (std::size_t pos = 0; pos < data.size(); pos += readSize) {
+            const std::size_t n = std::min(readSize, data.size() - pos);
+            buffer.append(data.data() + pos, n);
+            FrameView frame;
+            while (buffer.next_line(frame)) {
+                total += frame.size;
+            }
+        }
+    });
+
+    Bench::keep(total);
+    char name[96];
+    std::snprintf(name, sizeof(name), "%zu B frames, %zu B reads, erase front", frameSize, readSize);
+    Bench::report(name, double(frames) / eraseMs * 1e-3, "M frames/s");
+    std::snprintf(name, sizeof(name), "%zu B frames, %zu B reads, ReceiveBuffer", frameSize, readSize);
+    Bench::report(name, double(frames) / cursorMs * 1e-3, "M frames/s");
+}
+
+int main()
+{
+    bench(100000, 64, 64 * 1024);
+    bench(100000, 256, 64 * 1024);
+    bench(20000, 4096, 64 * 1024);
+    bench(100000, 256, 1500);
+}
@@ -0,0 +1,104 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Invokes submitted from 1 to 32 producer threads while the thread of the channel drains them
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/loopback_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+static void bench_queue(std::size_t producers)
+{
+    const std::size_t total = 1 << 20;
+    const std::size_t perProducer = total / producers;
+
+    const double ms = Bench::ms_per_run([&]() {
+        MpscQueue<std::size_t> queue;
+        std::vector<std::thread> threads;
+        for (std::size_t p = 0; p < producers; ++p) {
+            threads.emplace_back([&queue, perProducer]() {
+                for (std::size_t i = 0; i < perProducer; ++i) {
+                    queue.push(i);
+                }
+            });
+        }
+
+        std::size_t value = 0;
+        std::size_t sum = 0;
+        for (std::size_t popped = 0; popped < producers * perProducer;) {
+            if (queue.pop(value)) {
+                sum += value;
+                ++popped;
+            }
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        Bench::keep(sum);
+    }, 3);
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "queue, %zu producer(s)", producers);
+    Bench::report(name, ms * 1e6 / double(producers * perProducer), "ns/push");
+}
+
+static void bench_channel(std::size_t producers)
+{
+    const std::size_t total = 1 << 16;
+    const std::size_t perProducer = total / producers;
+
+    const double ms = Bench::ms_per_run([&]() {
+        LoopbackPair pair;
+        MockHost host(pair.host);
+        QWebChannel channel(pair.client, [](QWebChannel *) {});
+        pair.run();
+        QObject *object = channel.object("object0");
+
+        std::atomic<std::size_t> completed { 0 };
+        std::vector<std::thread> threads;
+        for (std::size_t p = 0; p < producers; ++p) {
+            threads.emplace_back([object, &completed, perProducer]() {
+                for (std::size_t i = 0; i < perProducer; ++i) {
+                    object->post_invoke("method0", { int(i) }, [&completed](ExecStatus, const nlohmann::json &) {
+                        completed.fetch_add(1, std::memory_order_relaxed);
+                    });
+                }
+            });
+        }
+
+        // the thread of the channel drains the submissions and runs the transport
+        while (completed.load(std::memory_order_relaxed) < producers * perProducer) {
+            channel.process_submissions();
+            pair.run();
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }, 3);
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "post_invoke, %zu producer(s)", producers);
+    Bench::report(name, 1e3 * double(producers * perProducer) / ms, "invokes/s");
+}
+
+int main()
+{
+    for (std::size_t producers = 1; producers <= 32; producers *= 2) {
+        bench_queue(producers);
+    }
+    for (std::size_t producers = 1; producers <= 32; producers *= 2) {
+        bench_channel(producers);
+    }
+}
@@ -0,0 +1,160 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Echo throughput over 1, 100 and 1000 loopback TCP connections, each with one message in
+// flight, with the io_uring transport and the asio one
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/asio_transport.h>
+#include <webchannelpp/uring_transport.h>
+
+#include <cstdio>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+// connected loopback TCP sockets
+static std::vector<std::pair<int, int>> connect_pairs(std::size_t count)
+{
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    listen(listener, 128);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+
+    std::vector<std::pair<int, int>> pairs;
+    for (std::size_t i = 0; i < count; ++i) {
+        const int client = socket(AF_INET, SOCK_STREAM, 0);
+        connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        const int server = accept(listener, nullptr, nullptr);
+        const int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        pairs.emplace_back(client, server);
+    }
+    close(listener);
+    return pairs;
+}
+
+// every client sends a message, the echo side returns it, and the client sends the next one
+template<class Transport, class RunOnce>
+static double run(std::vector<std::unique_ptr<Transport>> &clients, std::vector<std::unique_ptr<Transport>> &echoes,
+                  std::size_t total, RunOnce runOnce)
+{
+    const nlohmann::json message = { { "type", 6 }, { "object", "object0" }, { "property", 1 }, { "value", 42 } };
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    bool running = true;
+
+    for (std::size_t i = 0; i < clients.size(); ++i) {
+        Transport *client = clients[i].get();
+        Transport *echo = echoes[i].get();
+        echo->register_message_handler([echo](const nlohmann::json &m) { echo->send(m); });
+        client->register_message_handler([&, client](const nlohmann::json &) {
+            ++received;
+            if (running) {
+                ++sent;
+                client->send(message);
+            }
+        });
+    }
+
+    const double ms = Bench::ms_per_run([&]() {
+        const std::size_t target = received + total;
+        if (sent == 0) {
+            for (auto &client : clients) {
+                ++sent;
+                client->send(message);
+            }
+        }
+        while (received < target) {
+            runOnce();
+        }
+    }, 3);
+
+    // no messages in flight when the connections go away
+    running = false;
+    while (received < sent) {
+        runOnce();
+    }
+    return double(total) / ms;
+}
+
+static void bench_asio(std::size_t connections, std::size_t total)
+{
+    asio::io_context io;
+    std::vector<std::unique_ptr<asio::ip::tcp::socket>> sockets;
+    std::vector<std::unique_ptr<LengthPrefixedAsioTransport>> clients, echoes;
+    for (const auto &pair : connect_pairs(connections)) {
+        sockets.emplace_back(new asio::ip::tcp::socket(io, asio::ip::tcp::v4(), pair.first));
+        clients.emplace_back(new LengthPrefixedAsioTransport(*sockets.back()));
+        sockets.emplace_back(new asio::ip::tcp::socket(io, asio::ip::tcp::v4(), pair.second));
+        echoes.emplace_back(new LengthPrefixedAsioTransport(*sockets.back()));
+    }
+
+    const double rate = run(clients, echoes, total, [&]() { io.run_one(); });
+    char label[64];
+    std::snprintf(label, sizeof(label), "asio, %zu connections", connections);
+    Bench::report(label, rate, "k messages/s");
+
+    // the transports have to go before their sockets
+    clients.clear();
+    echoes.clear();
+}
+
+static void bench_uring(std::size_t connections, std::size_t total)
+{
+    const auto pairs = connect_pairs(connections);
+    {
+        UringLoop loop(1024, 1024, 4096);
+        std::vector<std::unique_ptr<LengthPrefixedUringTransport>> clients, echoes;
+        for (const auto &pair : pairs) {
+            clients.emplace_back(new LengthPrefixedUringTransport(loop, pair.first));
+            echoes.emplace_back(new LengthPrefixedUringTransport(loop, pair.second));
+        }
+
+        const double rate = run(clients, echoes, total, [&]() { loop.run_once(); });
+        char label[64];
+        std::snprintf(label, sizeof(label), "io_uring, %zu connections", connections);
+        Bench::report(label, rate, "k messages/s");
+
+        for (const auto &pair : pairs) {
+            shutdown(pair.first, SHUT_RDWR);
+        }
+        // let the cancelled receives complete before the transports go
+        while (loop.run_once(false) > 0) {
+        }
+    }
+    for (const auto &pair : pairs) {
+        close(pair.first);
+        close(pair.second);
+    }
+}
+
+int main()
+{
+    for (std::size_t connections : { 1, 100, 1000 }) {
+        bench_asio(connections, 100000);
+        try {
+            bench_uring(connections, 100000);
+        } catch (const std::system_error &e) {
+            std::printf("io_uring not available: %s\n", e.what());
+        }
+    }
+}
@@ -0,0 +1,123 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Size and encode/decode cost of the wire formats, on the traffic of a session with the mock
+// host: Init, invokes, property writes and updates, and signals
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/loopback_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace WebChannelPP;
+
+// host side transport that records every message passing it
+class RecordingTransport : public Transport
+{
+    LoopbackTransport &m_transport;
+    std::vector<nlohmann::json> &m_messages;
+
+public:
+    RecordingTransport(LoopbackTransport &transport, std::vector<nlohmann::json> &messages)
+        : m_transport(transport), m_messages(messages)
+    {
+    }
+
+    void send(const nlohmann::json &message) override
+    {
+        m_messages.push_back(message);
+        m_transport.send(message);
+    }
+
+    void register_message_handler(message_handler handler) override
+    {
+        m_transport.register_message_handler([this, handler](const nlohmann::json &message) {
+            m_messages.push_back(message);
+            handler(message);
+        });
+    }
+};
+
+static std::vector<nlohmann::json> record_session()
+{
+    std::vector<nlohmann::json> messages;
+    LoopbackPair pair;
+    RecordingTransport recorder(pair.host, messages);
+
+    MockHostConfig config;
+    config.objects = 20;
+    config.methods = 8;
+    config.properties = 8;
+    config.signals = 4;
+    MockHost host(recorder, config);
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+
+    for (const auto &entry : channel.objects()) {
+        entry.second->connect("signal0", [](int) {});
+    }
+    pair.run();
+
+    host.set_signal_rate(5);
+    host.set_property_update_rate(10);
+    QObject *object = channel.object("object3");
+    for (int i = 0; i < 200; ++i) {
+        object->invoke("method1", std::vector<nlohmann::json> { i, "argument", 2.5 * i },
+                       std::function<void(const nlohmann::json &)>());
+        object->set_property("property2", i);
+        host.tick();
+        pair.run();
+    }
+    return messages;
+}
+
+int main()
+{
+    const std::vector<nlohmann::json> messages = record_session();
+    std::printf("%zu messages\n", messages.size());
+
+    static const struct {
+        WireFormat format;
+        const char *name;
+    } formats[] = {
+        { WireFormat::Json, "JSON" },
+        { WireFormat::Cbor, "CBOR" },
+        { WireFormat::MessagePack, "MessagePack" },
+        { WireFormat::Ubjson, "UBJSON" },
+    };
+
+    for (const auto &entry : formats) {
+        BasicMessageEncoder<nlohmann::json> encoder(entry.format);
+        std::vector<std::string> encoded(messages.size());
+        std::size_t bytes = 0;
+        for (std::size_t i = 0; i < messages.size(); ++i) {
+            encoder.encode(messages[i], encoded[i]);
+            bytes += encoded[i].size();
+        }
+
+        std::string buffer;
+        const double encodeNs = Bench::ns_per_op(messages.size(), [&](std::size_t i) {
+            buffer.clear();
+            encoder.encode(messages[i], buffer);
+        });
+        const double decodeNs = Bench::ns_per_op(messages.size(), [&](std::size_t i) {
+            const nlohmann::json value = decode_message<nlohmann::json>(encoded[i].data(), encoded[i].size(), entry.format);
+            Bench::keep(value);
+        });
+
+        char label[96];
+        std::snprintf(label, sizeof(label), "%s, total size", entry.name);
+        Bench::report(label, double(bytes) / 1024, "KiB");
+        std::snprintf(label, sizeof(label), "%s, encode", entry.name);
+        Bench::report(label, encodeNs, "ns/message");
+        std::snprintf(label, sizeof(label), "%s, decode", entry.name);
+        Bench::report(label, decodeNs, "ns/message");
+    }
+}
@@ -7,48 +7,279 @@
 #ifndef ASIO_TRANSPORT_H
 #define ASIO_TRANSPORT_H
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <functional>
+#include <string>
 #include <vector>
 #include <asio.hpp>
 
 #include "qwebchannel_fwd.h"
+#include "buffer_pool.h"
+#include "framing.h"
+#include "receive_buffer.h"
+#include "wire_format.h"
 
 namespace WebChannelPP
 {
 
-class AsioTransport : public Transport
+/// @brief Counters for the write path of an AsioTransport
+struct WriteStats
 {
-    asio::ip::tcp::socket &m_socket;
-    std::vector<char> m_buffer;
+    /// Number of write operations issued to the socket
+    std::size_t writes = 0;
+    /// Number of messages sent by these writes
+    std::size_t messages = 0;
+    /// Number of bytes sent, including framing
+    std::size_t bytes = 0;
+
+    double messages_per_write() const { return writes ? double(messages) / writes : 0.0; }
+};
+
+/// @brief Transport over an asio stream socket.
+///
+/// The `Framing` policy defines how messages are delimited on the wire, see framing.h.
+/// `Socket` can be any asio stream socket, e.g. a TCP or a Unix domain socket.
+///
+/// All completion handlers of a transport run on its own strand, so many transports can share
+/// an io_context that is run by several threads. The channel attached to the transport is then
+/// only safe to use from that strand as well: construct it and call into its objects from
+/// handlers passed to `post()`. Message and backpressure handlers already run on the strand.
+template<class Framing = NewlineFraming, class Socket = asio::ip::tcp::socket>
+class BasicAsioTransport : public Transport
+{
+public:
+    typedef asio::strand<typename Socket::executor_type> strand_type;
+
+    /// @brief Called with `true` when the send queue exceeds the high-water mark and
+    ///        with `false` once it has drained to half of it again.
+    typedef std::function<void(bool)> backpressure_handler;
+
+    /// @brief Upper bound of messages gathered into a single write. asio hands at most
+    ///        64 buffers to one writev() call, and each message takes up to two of them.
+    static constexpr std::size_t max_coalesced_messages = 32;
+
+private:
+    struct OutgoingMessage
+    {
+        typename Framing::header_type header;
+        std::string payload;
+    };
+
+    Socket &m_socket;
+    strand_type m_strand;
+    ReceiveBuffer m_buffer;
+    std::size_t m_readSize = 4096;
+    std::size_t m_maxReadSize = 256 * 1024;
+    std::size_t m_maxFrameSize = 64 * 1024 * 1024;
     message_handler m_handler;
+    serialized_message_handler m_serializedHandler;
+    BasicMessageEncoder<nlohmann::json> m_encoder;
+
+    std::deque<OutgoingMessage> m_outbox;
+    BufferPool m_pool;
+    std::vector<asio::const_buffer> m_gather;
+    std::size_t m_inFlight = 0;
+    std::size_t m_queuedBytes = 0;
+    std::size_t m_highWaterMark = 1024 * 1024;
+    bool m_backpressure = false;
+    bool m_failed = false;
+    backpressure_handler m_backpressureHandler;
+
+    bool m_coalescing = false;
+    bool m_flushScheduled = false;
+    std::chrono::microseconds m_coalescingWindow { 0 };
+    asio::steady_timer m_flushTimer;
+    WriteStats m_stats;
+
 public:
-    explicit AsioTransport(asio::ip::tcp::socket &socket)
-        : m_socket(socket)
+    explicit BasicAsioTransport(Socket &socket)
+        : m_socket(socket), m_strand(socket.get_executor()), m_flushTimer(socket.get_executor())
     {
         std::cout << "Created Asio Adapter" << std::endl;
         async_read_more();
     }
 
+    /// @brief Returns the strand all handlers of this transport run on
+    const strand_type &strand() const { return m_strand; }
+
+    /// @brief Runs @p handler on the strand of this transport, e.g. to use the attached channel
+    ///        from another thread
+    template<class Handler>
+    void post(Handler &&handler)
+    {
+        asio::post(m_strand, std::forward<Handler>(handler));
+    }
+
+    WireFormat wire_format() const { return m_encoder.format(); }
+
+    /// @brief Selects the encoding of messages on the wire. Both ends of the connection
+    ///        must use the same format.
+    /// @return false if @p format is binary but the framing cannot carry binary payloads
+    bool set_wire_format(WireFormat format)
+    {
+        if (is_binary(format) && !Framing::binary_safe) {
+            std::cerr << "Binary wire formats require a binary-safe framing" << std::endl;
+            return false;
+        }
+
+        m_encoder.set_format(format);
+        return true;
+    }
+
+    std::size_t max_read_size() const { return m_maxReadSize; }
+    /// @brief Sets the upper bound for the amount of data requested from the socket per read
+    void set_max_read_size(std::size_t bytes) { m_maxReadSize = bytes; }
+
+    std::size_t max_frame_size() const { return m_maxFrameSize; }
+    /// @brief Sets the size of the largest incoming message. A peer announcing or sending a larger
+    ///        one is considered broken or hostile, and the connection is closed.
+    void set_max_frame_size(std::size_t bytes) { m_maxFrameSize = bytes; }
+
     void async_read_more()
     {
         using namespace std::placeholders;
-        m_socket.async_read_some(asio::null_buffers(), std::bind(&AsioTransport::read_some, this, _1, _2));
+        // with length-prefixed framing, ask for the whole remaining frame at once
+        const std::size_t wanted = std::max(m_readSize, Framing::bytes_needed(m_buffer));
+        m_socket.async_read_some(asio::buffer(m_buffer.prepare(wanted), wanted),
+                                 asio::bind_executor(m_strand, std::bind(&BasicAsioTransport::read_some, this, _1, _2)));
     }
 
-    void read_some(const asio::error_code &/*err*/, std::size_t /* nybtes */)
+    void read_some(const asio::error_code &err, std::size_t nbytes)
     {
-        std::vector<char> temp(m_socket.available());
-        m_socket.read_some(asio::buffer(temp));
-        m_buffer.insert(m_buffer.end(), temp.begin(), temp.end());
+        if (err) {
+            if (err != asio::error::operation_aborted) {
+                std::cerr << "Stopped reading: " << err.message() << std::endl;
+            }
+            return;
+        }
+
+        m_buffer.commit(nbytes);
+
+        // the socket had at least as much data as we asked for, ask for more next time
+        if (nbytes >= m_readSize && m_readSize < m_maxReadSize) {
+            m_readSize = std::min(m_readSize * 2, m_maxReadSize);
+        }
 
         process_messages();
 
+        // checked before reading on, so an oversized frame is never buffered
+        const std::size_t pending = Framing::pending_frame_size(m_buffer);
+        if (pending > m_maxFrameSize) {
+            std::cerr << "Incoming message of " << pending << " bytes exceeds the maximum of "
+                      << m_maxFrameSize << " bytes, closing connection" << std::endl;
+            asio::error_code ignored;
+            m_socket.close(ignored);
+            return;
+        }
+
         async_read_more();
     }
 
-    void send(const std::string &s) override
+    /// @brief Queues @p s for sending. Never blocks; the message is written asynchronously.
+    void send(const nlohmann::json &s) override
+    {
+        std::string payload = m_pool.acquire();
+        m_encoder.encode(s, payload);
+        enqueue(std::move(payload));
+    }
+
+    /// @brief Serialized messages are queued as they are, unless a binary wire format is used
+    bool accepts_serialized() const override { return !is_binary(m_encoder.format()); }
+
+    /// @brief Queues @p message for sending, like `send()`
+    void send_serialized(std::string &&message) override
     {
-        m_socket.write_some(asio::buffer(s + "\n"));
+        if (is_binary(m_encoder.format())) {
+            // transcode, the peer expects the binary format
+            std::string payload = m_pool.acquire();
+            m_encoder.encode(nlohmann::json::parse(message), payload);
+            m_pool.release(std::move(message));
+            enqueue(std::move(payload));
+            return;
+        }
+
+        enqueue(std::move(message));
+    }
+
+    std::string acquire_buffer() override { return m_pool.acquire(); }
+
+    /// @brief Returns the pool the payloads of sent messages are returned to
+    BufferPool &buffer_pool() { return m_pool; }
+
+    void enqueue(std::string &&payload)
+    {
+        if (m_failed) {
+            // the connection is gone, nothing will ever be written again
+            m_pool.release(std::move(payload));
+            return;
+        }
+
+        if (payload.size() > Framing::max_payload_size) {
+            std::cerr << "Cannot send a message of " << payload.size() << " bytes with this framing" << std::endl;
+            m_pool.release(std::move(payload));
+            return;
+        }
+
+        m_outbox.emplace_back();
+        OutgoingMessage &message = m_outbox.back();
+        message.payload = std::move(payload);
+        Framing::write_header(message.header, message.payload.size());
+        m_queuedBytes += Framing::header_size + message.payload.size() + Framing::trailer_size;
+
+        if (!m_backpressure && m_queuedBytes >= m_highWaterMark) {
+            set_backpressure(true);
+        }
+
+        if (m_inFlight > 0) {
+            // written by the completion handler of the running write
+            return;
+        }
+
+        if (!m_coalescing) {
+            write_next();
+        } else {
+            schedule_flush();
+        }
+    }
+
+    /// @brief Returns whether write coalescing is enabled
+    bool coalescing() const { return m_coalescing; }
+
+    /// @brief Enables or disables write coalescing.
+    ///
+    /// When enabled, sent messages are not written immediately. Instead, all messages queued
+    /// until the end of the current event loop turn (or until the coalescing window expires)
+    /// are written with a single gathering write.
+    void set_coalescing(bool enabled) { m_coalescing = enabled; }
+
+    std::chrono::microseconds coalescing_window() const { return m_coalescingWindow; }
+    /// @brief Sets how long queued messages may be held back for coalescing. With a window of
+    ///        zero (the default), messages are held until the end of the current event loop turn.
+    void set_coalescing_window(std::chrono::microseconds window) { m_coalescingWindow = window; }
+
+    /// @brief Returns the write statistics of this transport
+    const WriteStats &write_stats() const { return m_stats; }
+    void reset_write_stats() { m_stats = WriteStats(); }
+
+    /// @brief Returns the number of bytes queued but not yet written to the socket
+    std::size_t queued_bytes() const { return m_queuedBytes; }
+
+    /// @brief Returns whether the send queue is currently above the high-water mark
+    bool backpressure() const { return m_backpressure; }
+
+    /// @brief Returns whether a write failed. Queued messages were dropped then, and later ones
+    ///        are dropped right away.
+    bool failed() const { return m_failed; }
+
+    std::size_t high_water_mark() const { return m_highWaterMark; }
+    /// @brief Sets the number of queued bytes at which backpressure is reported
+    void set_high_water_mark(std::size_t bytes) { m_highWaterMark = bytes; }
+
+    void register_backpressure_handler(backpressure_handler handler)
+    {
+        m_backpressureHandler = std::move(handler);
     }
 
     void register_message_handler(message_handler handler) override
@@ -56,23 +287,167 @@ public:
         m_handler = std::move(handler);
     }
 
+    /// @brief Messages in the JSON wire format are passed to @p handler without being parsed
+    bool register_serialized_message_handler(serialized_message_handler handler) override
+    {
+        m_serializedHandler = std::move(handler);
+        return true;
+    }
+
+    void schedule_flush()
+    {
+        if (m_flushScheduled) {
+            return;
+        }
+        m_flushScheduled = true;
+
+        if (m_coalescingWindow.count() == 0) {
+            asio::post(m_strand, std::bind(&BasicAsioTransport::flush, this));
+            return;
+        }
+
+        m_flushTimer.expires_after(m_coalescingWindow);
+        m_flushTimer.async_wait(asio::bind_executor(m_strand, [this](const asio::error_code &err) {
+            if (err != asio::error::operation_aborted) {
+                flush();
+            }
+        }));
+    }
+
+    void flush()
+    {
+        m_flushScheduled = false;
+
+        if (m_inFlight == 0 && !m_outbox.empty()) {
+            write_next();
+        }
+    }
+
+    void write_next()
+    {
+        using namespace std::placeholders;
+
+        std::size_t count = 1;
+        if (m_coalescing) {
+            count = m_outbox.size() < max_coalesced_messages ? m_outbox.size() : max_coalesced_messages;
+        }
+
+        m_gather.clear();
+        for (std::size_t i = 0; i < count; ++i) {
+            OutgoingMessage &message = m_outbox[i];
+            if (Framing::header_size > 0) {
+                m_gather.push_back(asio::buffer(message.header));
+            }
+            m_gather.push_back(asio::buffer(message.payload));
+            if (Framing::trailer_size > 0) {
+                m_gather.push_back(asio::buffer(Framing::trailer(), Framing::trailer_size));
+            }
+        }
+        m_inFlight = count;
+
+        // async_write keeps issuing writes until all buffers are fully sent
+        asio::async_write(m_socket, m_gather,
+                          asio::bind_executor(m_strand, std::bind(&BasicAsioTransport::write_done, this, _1, _2)));
+    }
+
+    void write_done(const asio::error_code &err, std::size_t nbytes)
+    {
+        const std::size_t count = m_inFlight;
+        m_inFlight = 0;
+
+        if (err) {
+            std::cerr << "Failed to send message: " << err.message() << std::endl;
+            fail();
+            return;
+        }
+
+        m_stats.writes++;
+        m_stats.messages += count;
+        m_stats.bytes += nbytes;
+
+        m_queuedBytes -= nbytes;
+        for (std::size_t i = 0; i < count; ++i) {
+            m_pool.release(std::move(m_outbox[i].payload));
+        }
+        m_outbox.erase(m_outbox.begin(), m_outbox.begin() + count);
+
+        if (m_backpressure && m_queuedBytes <= m_highWaterMark / 2) {
+            set_backpressure(false);
+        }
+
+        if (!m_outbox.empty()) {
+            // everything queued while writing is sent in the next batch
+            write_next();
+        }
+    }
+
+    // Drops everything queued after a failed write, so nothing waits for a write that never comes
+    void fail()
+    {
+        m_failed = true;
+
+        for (auto &message : m_outbox) {
+            m_pool.release(std::move(message.payload));
+        }
+        m_outbox.clear();
+        m_queuedBytes = 0;
+
+        if (m_backpressure) {
+            set_backpressure(false);
+        }
+    }
+
+    void set_backpressure(bool enabled)
+    {
+        m_backpressure = enabled;
+        if (m_backpressureHandler) {
+            m_backpressureHandler(enabled);
+        }
+    }
+
     void process_messages()
     {
-        for (auto it = std::find(m_buffer.begin(), m_buffer.end(), '\n');
-             it != m_buffer.end();
-             it = std::find(m_buffer.begin(), m_buffer.end(), '\n'))
-        {
-            std::string msg(m_buffer.data(), std::distance(m_buffer.begin(), it));
-            it++;
-            m_buffer.erase(m_buffer.begin(), it);
+        FrameView frame;
+        while (Framing::next_frame(m_buffer, frame)) {
+            if (m_serializedHandler && !is_binary(m_encoder.format())) {
+                m_serializedHandler(frame.data, frame.size);
+                continue;
+            }
 
-            if (m_handler) {
-                m_handler(msg);
+            if (!m_handler) {
+                continue;
             }
+
+            nlohmann::json msg;
+            try {
+                msg = decode_message<nlohmann::json>(frame.data, frame.size, m_encoder.format());
+            } catch (const nlohmann::json::exception &e) {
+                std::cerr << "Invalid message received: " << e.what() << std::endl;
+                continue;
+            }
+
+            m_handler(msg);
         }
     }
 };
 
+using AsioTransport = BasicAsioTransport<>;
+using LengthPrefixedAsioTransport = BasicAsioTransport<LengthPrefixedFraming>;
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+/// @brief Transports over Unix domain sockets, for hosts running on the same machine
+using LocalAsioTransport = BasicAsioTransport<NewlineFraming, asio::local::stream_protocol::socket>;
+using LengthPrefixedLocalAsioTransport = BasicAsioTransport<LengthPrefixedFraming, asio::local::stream_protocol::socket>;
+
+/// @brief Returns the endpoint for @p name in the Linux abstract socket namespace.
+///
+/// Abstract sockets have no file system entry and vanish with the last socket using them.
+inline asio::local::stream_protocol::endpoint abstract_endpoint(const std::string &name)
+{
+    return asio::local::stream_protocol::endpoint(std::string(1, '\0') + name);
+}
+#endif
+
 }
 
 #endif // ASIO_TRANSPORT_H
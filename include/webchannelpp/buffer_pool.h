@@ -0,0 +1,68 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace WebChannelPP
+{
+
+/// @brief Free list of message buffers.
+///
+/// Transports hand out buffers with `acquire()` and take them back once the message has been
+/// written, so that in steady state serializing a message does not allocate. Buffers that
+/// grew beyond `max_capacity()` are dropped instead of being kept around.
+/// Not thread-safe; each transport owns its pool.
+class BufferPool
+{
+    std::vector<std::string> m_free;
+    std::size_t m_maxBuffers;
+    std::size_t m_maxCapacity;
+
+public:
+    explicit BufferPool(std::size_t maxBuffers = 64, std::size_t maxCapacity = 64 * 1024)
+        : m_maxBuffers(maxBuffers), m_maxCapacity(maxCapacity)
+    {
+    }
+
+    /// @brief Returns an empty buffer, reusing a released one if possible
+    std::string acquire()
+    {
+        if (m_free.empty()) {
+            return std::string();
+        }
+
+        std::string buffer = std::move(m_free.back());
+        m_free.pop_back();
+        return buffer;
+    }
+
+    /// @brief Returns @p buffer to the pool
+    void release(std::string &&buffer)
+    {
+        if (m_free.size() >= m_maxBuffers || buffer.capacity() > m_maxCapacity) {
+            return;
+        }
+
+        buffer.clear();
+        m_free.push_back(std::move(buffer));
+    }
+
+    /// @brief Returns the number of buffers ready for reuse
+    std::size_t size() const { return m_free.size(); }
+
+    std::size_t max_buffers() const { return m_maxBuffers; }
+    std::size_t max_capacity() const { return m_maxCapacity; }
+};
+
+}
+
+#endif // BUFFER_POOL_H
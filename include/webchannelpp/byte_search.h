@@ -0,0 +1,95 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef BYTE_SEARCH_H
+#define BYTE_SEARCH_H
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WEBCHANNELPP_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace WebChannelPP
+{
+
+namespace detail
+{
+
+typedef const char *(*find_byte_fn)(const char *first, const char *last, char value);
+
+inline const char *find_byte_scalar(const char *first, const char *last, char value)
+{
+    const void *pos = std::memchr(first, value, last - first);
+    return pos ? static_cast<const char*>(pos) : last;
+}
+
+#ifdef WEBCHANNELPP_X86_SIMD
+
+__attribute__((target("sse2")))
+inline const char *find_byte_sse2(const char *first, const char *last, char value)
+{
+    const __m128i needle = _mm_set1_epi8(value);
+    for (; last - first >= 16; first += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask) {
+            return first + __builtin_ctz(mask);
+        }
+    }
+    return find_byte_scalar(first, last, value);
+}
+
+__attribute__((target("avx2")))
+inline const char *find_byte_avx2(const char *first, const char *last, char value)
+{
+    const __m256i needle = _mm256_set1_epi8(value);
+    for (; last - first >= 32; first += 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+        if (mask) {
+            return first + __builtin_ctz(mask);
+        }
+    }
+    return find_byte_sse2(first, last, value);
+}
+
+inline find_byte_fn select_find_byte()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return find_byte_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return find_byte_sse2;
+    }
+    return find_byte_scalar;
+}
+
+#else
+
+inline find_byte_fn select_find_byte()
+{
+    return find_byte_scalar;
+}
+
+#endif
+
+}
+
+/// @brief Returns a pointer to the first occurrence of @p value in [@p first, @p last), or @p last.
+///
+/// Uses AVX2 or SSE2 when the CPU supports it, as detected on first use, and `memchr` otherwise.
+inline const char *find_byte(const char *first, const char *last, char value)
+{
+    static const detail::find_byte_fn impl = detail::select_find_byte();
+    return impl(first, last, value);
+}
+
+}
+
+#endif // BYTE_SEARCH_H
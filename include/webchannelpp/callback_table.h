@@ -0,0 +1,141 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef CALLBACK_TABLE_H
+#define CALLBACK_TABLE_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace WebChannelPP
+{
+
+/// @brief Callbacks of in-flight requests, keyed by the request id sent to the host.
+///
+/// The table hands out the ids itself: they increase monotonically and the slot of an id is
+/// its lower bits, so inserting and completing a request are O(1) without allocations. Each
+/// slot remembers the full id it was handed out for, which makes responses with stale or
+/// unknown ids easy to reject. Ids whose slot is still taken by a long-running request are
+/// skipped, and the table doubles in size once it is half full.
+template<class Callback>
+class CallbackTable
+{
+    struct Slot
+    {
+        unsigned int id = 0;
+        bool used = false;
+        Callback callback;
+    };
+
+    std::vector<Slot> m_slots;
+    std::size_t m_mask;
+    std::size_t m_size = 0;
+    unsigned int m_nextId = 0;
+
+public:
+    /// @param capacity Initial number of slots, rounded up to a power of two
+    explicit CallbackTable(std::size_t capacity = 64)
+    {
+        std::size_t slots = 1;
+        while (slots < capacity) {
+            slots *= 2;
+        }
+        m_slots.resize(slots);
+        m_mask = slots - 1;
+    }
+
+    /// @brief Stores @p callback and returns the id of the new request
+    unsigned int insert(Callback callback)
+    {
+        if (2 * (m_size + 1) > m_slots.size()) {
+            grow();
+        }
+
+        while (m_slots[m_nextId & m_mask].used) {
+            ++m_nextId;
+        }
+
+        const unsigned int id = m_nextId++;
+        Slot &slot = m_slots[id & m_mask];
+        slot.id = id;
+        slot.used = true;
+        slot.callback = std::move(callback);
+        ++m_size;
+        return id;
+    }
+
+    /// @brief Removes the request @p id and moves its callback to @p callback
+    /// @return false if there is no request with @p id, e.g. because it already completed
+    bool take(unsigned int id, Callback &callback)
+    {
+        Slot &slot = m_slots[id & m_mask];
+        if (!slot.used || slot.id != id) {
+            return false;
+        }
+
+        callback = std::move(slot.callback);
+        slot.callback = Callback();
+        slot.used = false;
+        --m_size;
+        return true;
+    }
+
+    /// @brief Returns whether the request @p id is in flight
+    bool contains(unsigned int id) const
+    {
+        const Slot &slot = m_slots[id & m_mask];
+        return slot.used && slot.id == id;
+    }
+
+    /// @brief Returns the number of requests in flight
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /// @brief Returns the number of slots
+    std::size_t capacity() const { return m_slots.size(); }
+
+private:
+    void grow()
+    {
+        std::vector<Slot> entries;
+        entries.reserve(m_size);
+        for (Slot &slot : m_slots) {
+            if (slot.used) {
+                entries.push_back(std::move(slot));
+            }
+        }
+
+        // ids in flight may span more than the new size; grow further until none collide
+        std::size_t size = 2 * m_slots.size();
+        while (!fits(entries, size - 1)) {
+            size *= 2;
+        }
+
+        std::vector<Slot> slots(size);
+        for (Slot &slot : entries) {
+            slots[slot.id & (size - 1)] = std::move(slot);
+        }
+        m_slots = std::move(slots);
+        m_mask = size - 1;
+    }
+
+    static bool fits(const std::vector<Slot> &entries, std::size_t mask)
+    {
+        std::vector<bool> taken(mask + 1);
+        for (const Slot &slot : entries) {
+            if (taken[slot.id & mask]) {
+                return false;
+            }
+            taken[slot.id & mask] = true;
+        }
+        return true;
+    }
+};
+
+}
+
+#endif // CALLBACK_TABLE_H
@@ -0,0 +1,372 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include "qwebchannelpp.h"
+
+// Coroutine support needs C++20; with older standards this header provides nothing
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L && defined(__has_include)
+#if __has_include(<coroutine>)
+#define WEBCHANNELPP_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef WEBCHANNELPP_HAS_COROUTINES
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace WebChannelPP
+{
+
+/// @brief Status and value a coroutine receives from awaiting a request
+template<class T>
+struct ExecResult
+{
+    ExecStatus status;
+    T value;
+
+    explicit operator bool() const { return status == ExecStatus::Ok; }
+};
+
+/// @brief Allocates the frames of Task coroutines, see `set_frame_allocator()`
+class FrameAllocator
+{
+public:
+    virtual ~FrameAllocator() = default;
+    virtual void *allocate(std::size_t size) = 0;
+    virtual void deallocate(void *ptr, std::size_t size) noexcept = 0;
+};
+
+/// @brief Keeps freed frames for reuse, in size classes of 64 bytes up to 2 KiB.
+///
+/// Coroutines of the same function have frames of the same size, so in steady state
+/// starting one does not allocate. Not thread-safe.
+class RecyclingFrameAllocator : public FrameAllocator
+{
+    static constexpr std::size_t granularity = 64;
+    static constexpr std::size_t classes = 32;
+
+    std::vector<void*> m_free[classes];
+
+public:
+    ~RecyclingFrameAllocator() override
+    {
+        for (auto &list : m_free) {
+            for (void *ptr : list) {
+                ::operator delete(ptr);
+            }
+        }
+    }
+
+    void *allocate(std::size_t size) override
+    {
+        const std::size_t index = size_class(size);
+        if (index < classes && !m_free[index].empty()) {
+            void *ptr = m_free[index].back();
+            m_free[index].pop_back();
+            return ptr;
+        }
+        return ::operator new(index < classes ? (index + 1) * granularity : size);
+    }
+
+    void deallocate(void *ptr, std::size_t size) noexcept override
+    {
+        const std::size_t index = size_class(size);
+        if (index < classes) {
+            try {
+                m_free[index].push_back(ptr);
+                return;
+            } catch (...) {
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+private:
+    static std::size_t size_class(std::size_t size) { return (size + granularity - 1) / granularity - 1; }
+};
+
+namespace detail
+{
+
+inline FrameAllocator *&frame_allocator()
+{
+    static thread_local FrameAllocator *allocator = nullptr;
+    return allocator;
+}
+
+// Frames remember their allocator, so they can be freed after it was replaced
+struct FramePromiseBase
+{
+    static constexpr std::size_t header = alignof(std::max_align_t);
+
+    static void *operator new(std::size_t size)
+    {
+        FrameAllocator *allocator = frame_allocator();
+        void *block = allocator ? allocator->allocate(size + header) : ::operator new(size + header);
+        *static_cast<FrameAllocator**>(block) = allocator;
+        return static_cast<char*>(block) + header;
+    }
+
+    static void operator delete(void *ptr, std::size_t size) noexcept
+    {
+        void *block = static_cast<char*>(ptr) - header;
+        FrameAllocator *allocator = *static_cast<FrameAllocator**>(block);
+        if (allocator) {
+            allocator->deallocate(block, size + header);
+        } else {
+            ::operator delete(block);
+        }
+    }
+};
+
+template<class T>
+struct TaskResult
+{
+    std::optional<T> value;
+
+    void return_value(T val) { value.emplace(std::move(val)); }
+    T take() { return std::move(*value); }
+};
+
+template<>
+struct TaskResult<void>
+{
+    void return_void() {}
+    void take() {}
+};
+
+}
+
+/// @brief Sets the allocator for the frames of Task coroutines started on this thread.
+///        nullptr selects the global operator new. The allocator must outlive the frames.
+inline void set_frame_allocator(FrameAllocator *allocator)
+{
+    detail::frame_allocator() = allocator;
+}
+
+/// @brief Return type of coroutines using the channel.
+///
+/// Tasks start when they are awaited by another coroutine, or when passed to `spawn()`.
+template<class T = void>
+class Task
+{
+public:
+    struct promise_type : detail::FramePromiseBase, detail::TaskResult<T>
+    {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+            {
+                const auto continuation = handle.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+public:
+    Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    bool await_ready() const { return !m_handle || m_handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+    {
+        m_handle.promise().continuation = awaiting;
+        return m_handle;
+    }
+
+    T await_resume()
+    {
+        if (m_handle.promise().exception) {
+            std::rethrow_exception(m_handle.promise().exception);
+        }
+        return m_handle.promise().take();
+    }
+};
+
+namespace detail
+{
+
+struct DetachedTask
+{
+    struct promise_type : FramePromiseBase
+    {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception()
+        {
+            std::cerr << "Unhandled exception in a spawned task" << std::endl;
+            std::terminate();
+        }
+    };
+};
+
+inline DetachedTask run_detached(Task<void> task)
+{
+    co_await task;
+}
+
+}
+
+/// @brief Starts @p task. It runs until its first suspension right away and frees itself
+///        when done.
+inline void spawn(Task<void> task)
+{
+    detail::run_detached(std::move(task));
+}
+
+template<class T>
+struct FutureAwaiter
+{
+    Future<T> future;
+
+    bool await_ready() const { return future.is_ready(); }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        future.then([handle](ExecStatus, const T &) { handle.resume(); });
+    }
+    ExecResult<T> await_resume() const { return ExecResult<T> { future.status(), future.value() }; }
+};
+
+/// @brief Awaits the result of a request, e.g. `co_await object->invoke_async("method", args)`
+template<class T>
+FutureAwaiter<T> operator co_await(Future<T> future)
+{
+    return FutureAwaiter<T> { std::move(future) };
+}
+
+/// @brief Awaitable for the next emission of a signal, see `next_signal()`
+template<class Json>
+class SignalAwaiter
+{
+public:
+    using json_t = Json;
+    using string_t = typename json_t::string_t;
+
+private:
+    BasicQObject<json_t> *m_object;
+    string_t m_signal;
+    unsigned int m_connection = 0;
+    std::vector<json_t> m_args;
+
+public:
+    SignalAwaiter(BasicQObject<json_t> *object, string_t signal)
+        : m_object(object), m_signal(std::move(signal))
+    {
+    }
+
+    bool await_ready() const { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        // the callback holds a pointer to this awaiter, which lives in the suspended frame. It
+        // resumes the coroutine, so it has to run on the thread of the channel.
+        m_connection = m_object->connect_direct(m_signal, std::function<void(const std::vector<json_t> &)>(
+                                                    [this, handle](const std::vector<json_t> &args) {
+            m_args = args;
+            m_object->disconnect(m_connection);
+            handle.resume();
+        }));
+
+        // don't suspend if the signal does not exist
+        return m_connection != 0;
+    }
+
+    ExecResult<std::vector<json_t>> await_resume()
+    {
+        if (m_connection == 0) {
+            return { ExecStatus::Failed, {} };
+        }
+        return { ExecStatus::Ok, std::move(m_args) };
+    }
+};
+
+/// @brief Awaits the next emission of @p signal of @p object and yields its arguments.
+///        Fails with ExecStatus::Failed if the object has no such signal.
+template<class Json>
+SignalAwaiter<Json> next_signal(BasicQObject<Json> *object, typename Json::string_t signal)
+{
+    return SignalAwaiter<Json>(object, std::move(signal));
+}
+
+/// @brief Awaits the next change of @p property of @p object and yields its new value
+template<class Json>
+Task<ExecResult<Json>> next_property_change(BasicQObject<Json> *object, typename Json::string_t property)
+{
+    const auto signal = object->notifySignalForProperty(property);
+    if (signal.empty()) {
+        co_return ExecResult<Json> { ExecStatus::Failed, Json() };
+    }
+
+    const auto emitted = co_await next_signal(object, signal);
+    if (!emitted) {
+        co_return ExecResult<Json> { emitted.status, Json() };
+    }
+    co_return ExecResult<Json> { ExecStatus::Ok, object->property(property).json() };
+}
+
+/// @brief Awaitable for the initialization of a channel, see `channel_ready()`
+template<class Json>
+struct ChannelReadyAwaiter
+{
+    BasicQWebChannel<Json> *channel;
+
+    bool await_ready() const { return channel->initialized(); }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        channel->when_initialized([handle](BasicQWebChannel<Json> *) { handle.resume(); });
+    }
+    BasicQWebChannel<Json> *await_resume() const { return channel; }
+};
+
+/// @brief Awaits until @p channel knows the objects of the host
+template<class Json>
+ChannelReadyAwaiter<Json> channel_ready(BasicQWebChannel<Json> &channel)
+{
+    return ChannelReadyAwaiter<Json> { &channel };
+}
+
+}
+
+#endif // WEBCHANNELPP_HAS_COROUTINES
+
+#endif // COROUTINE_H
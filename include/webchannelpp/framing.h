@@ -0,0 +1,133 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "receive_buffer.h"
+
+namespace WebChannelPP
+{
+
+/// @brief Framing policy for newline-delimited messages.
+///
+/// Every payload is followed by a single '\n'. Payloads must not contain newlines, which
+/// rules out binary encodings.
+struct NewlineFraming
+{
+    typedef std::array<char, 0> header_type;
+
+    static constexpr std::size_t header_size = 0;
+    static constexpr std::size_t trailer_size = 1;
+    /// Whether payloads may contain arbitrary bytes
+    static constexpr bool binary_safe = false;
+    /// Largest payload a frame can carry
+    static constexpr std::size_t max_payload_size = std::numeric_limits<std::size_t>::max();
+
+    static void write_header(header_type &, std::size_t /* payload_size */) {}
+
+    static const char *trailer()
+    {
+        static const char delimiter = '\n';
+        return &delimiter;
+    }
+
+    /// @brief Returns the number of bytes still missing for the next frame, or 0 if unknown
+    static std::size_t bytes_needed(const ReceiveBuffer &)
+    {
+        return 0;
+    }
+
+    /// @brief Returns the payload size of the incomplete frame at the front of @p buffer, as far as it is known.
+    ///        Only meaningful once all complete frames have been taken out.
+    static std::size_t pending_frame_size(const ReceiveBuffer &buffer)
+    {
+        // an unterminated line
+        return buffer.size();
+    }
+
+    static bool next_frame(ReceiveBuffer &buffer, FrameView &frame)
+    {
+        return buffer.next_line(frame, '\n');
+    }
+};
+
+/// @brief Framing policy for messages prefixed with their length.
+///
+/// Every payload is preceded by its size as a 4 byte big-endian unsigned integer. Frames are
+/// extracted without looking at the payload, and payloads may contain arbitrary bytes.
+struct LengthPrefixedFraming
+{
+    typedef std::array<char, 4> header_type;
+
+    static constexpr std::size_t header_size = 4;
+    static constexpr std::size_t trailer_size = 0;
+    static constexpr bool binary_safe = true;
+    static constexpr std::size_t max_payload_size = 0xffffffffu;
+
+    /// @p payload_size must not exceed max_payload_size
+    static void write_header(header_type &header, std::size_t payload_size)
+    {
+        const std::uint32_t size = static_cast<std::uint32_t>(payload_size);
+        header[0] = static_cast<char>(size >> 24);
+        header[1] = static_cast<char>(size >> 16);
+        header[2] = static_cast<char>(size >> 8);
+        header[3] = static_cast<char>(size);
+    }
+
+    static const char *trailer()
+    {
+        return nullptr;
+    }
+
+    static std::size_t bytes_needed(const ReceiveBuffer &buffer)
+    {
+        if (buffer.size() < header_size) {
+            return header_size - buffer.size();
+        }
+        const std::size_t frame_size = header_size + read_header(buffer.data());
+        return frame_size > buffer.size() ? frame_size - buffer.size() : 0;
+    }
+
+    static std::size_t pending_frame_size(const ReceiveBuffer &buffer)
+    {
+        // the header announces the size before the payload arrives
+        return buffer.size() < header_size ? 0 : read_header(buffer.data());
+    }
+
+    static bool next_frame(ReceiveBuffer &buffer, FrameView &frame)
+    {
+        if (buffer.size() < header_size) {
+            return false;
+        }
+
+        const std::size_t length = read_header(buffer.data());
+        if (buffer.size() < header_size + length) {
+            return false;
+        }
+
+        frame = FrameView { buffer.data() + header_size, length };
+        buffer.consume(header_size + length);
+        return true;
+    }
+
+private:
+    static std::size_t read_header(const char *data)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+        return (std::uint32_t(bytes[0]) << 24) | (std::uint32_t(bytes[1]) << 16) |
+               (std::uint32_t(bytes[2]) << 8) | std::uint32_t(bytes[3]);
+    }
+};
+
+}
+
+#endif // FRAMING_H
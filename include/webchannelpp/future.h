@@ -0,0 +1,243 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef FUTURE_H
+#define FUTURE_H
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "qwebchannel_fwd.h"
+
+namespace WebChannelPP
+{
+
+namespace detail
+{
+
+// Shared by a Future and its Promise. Only ever touched from the thread running the channel,
+// so the reference count is a plain integer.
+template<class T>
+struct FutureState
+{
+    std::size_t refs = 1;
+    bool ready = false;
+    ExecStatus status = ExecStatus::Ok;
+    T value {};
+    // most futures have a single continuation, which is kept without allocating
+    std::function<void(ExecStatus, const T &)> continuation;
+    std::vector<std::function<void(ExecStatus, const T &)>> moreContinuations;
+
+    template<class Continuation>
+    void add_continuation(Continuation &&callback)
+    {
+        if (!continuation) {
+            continuation = std::forward<Continuation>(callback);
+        } else {
+            moreContinuations.emplace_back(std::forward<Continuation>(callback));
+        }
+    }
+
+    void complete(ExecStatus result, T &&val)
+    {
+        if (ready) {
+            return;
+        }
+
+        ready = true;
+        status = result;
+        value = std::move(val);
+
+        if (!continuation) {
+            return;
+        }
+
+        auto first = std::move(continuation);
+        auto more = std::move(moreContinuations);
+        continuation = nullptr;
+        moreContinuations.clear();
+
+        first(status, value);
+        for (const auto &callback : more) {
+            callback(status, value);
+        }
+    }
+};
+
+// Intrusive handle to a FutureState
+template<class T>
+class FutureStateRef
+{
+protected:
+    FutureState<T> *m_state;
+
+    explicit FutureStateRef(FutureState<T> *state) : m_state(state) {}
+
+public:
+    FutureStateRef(const FutureStateRef &other) : m_state(other.m_state)
+    {
+        if (m_state) {
+            ++m_state->refs;
+        }
+    }
+
+    FutureStateRef(FutureStateRef &&other) : m_state(other.m_state)
+    {
+        other.m_state = nullptr;
+    }
+
+    FutureStateRef &operator=(FutureStateRef other)
+    {
+        std::swap(m_state, other.m_state);
+        return *this;
+    }
+
+    ~FutureStateRef()
+    {
+        if (m_state && --m_state->refs == 0) {
+            delete m_state;
+        }
+    }
+};
+
+}
+
+template<class T>
+class Promise;
+
+/// @brief Result of an asynchronous request, e.g. of `BasicQObject::invoke_async()`.
+///
+/// Futures never block. They are meant for the thread that runs the channel: `then()` runs
+/// its continuation as soon as the result arrives, or right away if it is already there.
+/// Copies share the same result. Combine many of them with `when_all()`.
+template<class T>
+class Future : public detail::FutureStateRef<T>
+{
+    using detail::FutureStateRef<T>::m_state;
+
+    explicit Future(detail::FutureState<T> *state) : detail::FutureStateRef<T>(state)
+    {
+        ++m_state->refs;
+    }
+
+    friend class Promise<T>;
+
+public:
+    Future() : detail::FutureStateRef<T>(nullptr) {}
+
+    /// @brief Returns whether the future refers to a request
+    bool valid() const { return m_state != nullptr; }
+
+    /// @brief Returns whether the result has arrived
+    bool is_ready() const { return m_state && m_state->ready; }
+
+    /// @brief Returns the outcome of the request. Only meaningful once the future is ready.
+    ExecStatus status() const { return m_state->status; }
+
+    /// @brief Returns the result. Only meaningful once the future is ready with ExecStatus::Ok.
+    const T &value() const { return m_state->value; }
+
+    /// @brief Calls @p continuation with the status and the result once the future is ready.
+    ///        A future may have several continuations, which run in the order they were added.
+    template<class Continuation>
+    void then(Continuation &&continuation)
+    {
+        if (m_state->ready) {
+            continuation(m_state->status, m_state->value);
+            return;
+        }
+
+        m_state->add_continuation(std::forward<Continuation>(continuation));
+    }
+};
+
+/// @brief Producing side of a Future
+template<class T>
+class Promise : public detail::FutureStateRef<T>
+{
+    using detail::FutureStateRef<T>::m_state;
+
+public:
+    Promise() : detail::FutureStateRef<T>(new detail::FutureState<T>()) {}
+
+    Future<T> get_future() const { return Future<T>(m_state); }
+
+    /// @brief Completes the future with ExecStatus::Ok and @p value
+    void set_value(T value) { m_state->complete(ExecStatus::Ok, std::move(value)); }
+
+    /// @brief Completes the future with the failure @p status
+    void set_status(ExecStatus status) { m_state->complete(status, T()); }
+};
+
+namespace detail
+{
+
+template<class T>
+struct JoinState
+{
+    Promise<std::vector<T>> promise;
+    std::vector<T> values;
+    std::size_t remaining;
+    ExecStatus status = ExecStatus::Ok;
+
+    void complete(std::size_t index, ExecStatus result, const T &value)
+    {
+        if (result != ExecStatus::Ok && status == ExecStatus::Ok) {
+            status = result;
+        }
+        values[index] = value;
+
+        if (--remaining > 0) {
+            return;
+        }
+
+        if (status == ExecStatus::Ok) {
+            promise.set_value(std::move(values));
+        } else {
+            promise.set_status(status);
+        }
+        delete this;
+    }
+};
+
+}
+
+/// @brief Returns a future for the results of all @p futures, in the same order.
+///
+/// It becomes ready once every future is ready. If any of them failed, it fails with the
+/// status of the first failure in order of arrival.
+template<class T>
+Future<std::vector<T>> when_all(const std::vector<Future<T>> &futures)
+{
+    auto *join = new detail::JoinState<T>();
+    Future<std::vector<T>> result = join->promise.get_future();
+
+    if (futures.empty()) {
+        join->promise.set_value(std::vector<T>());
+        delete join;
+        return result;
+    }
+
+    join->values.resize(futures.size());
+    join->remaining = futures.size();
+
+    // the join deletes itself with the last result, which may be here already
+    for (std::size_t i = 0; i < futures.size(); ++i) {
+        Future<T> future = futures[i];
+        // small enough to be stored in the std::function without allocating
+        future.then([join, i](ExecStatus status, const T &value) {
+            join->complete(i, status, value);
+        });
+    }
+
+    return result;
+}
+
+}
+
+#endif // FUTURE_H
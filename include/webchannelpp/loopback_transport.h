@@ -0,0 +1,158 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef LOOPBACK_TRANSPORT_H
+#define LOOPBACK_TRANSPORT_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+
+#include "qwebchannel_fwd.h"
+
+namespace WebChannelPP
+{
+
+/// @brief One end of an in-process transport pair, see BasicLoopbackPair.
+///
+/// Sent messages are queued at the peer and only delivered by `process()`, so handlers never
+/// run re-entrantly from within `send()` and the order of events is fully deterministic.
+template<class Json = nlohmann::json>
+class BasicLoopbackTransport : public BasicTransport<Json>
+{
+public:
+    using typename BasicTransport<Json>::message_handler;
+    using typename BasicTransport<Json>::serialized_message_handler;
+
+private:
+    // a message is queued either as JSON text or as a DOM
+    struct Message
+    {
+        std::string text;
+        Json json;
+    };
+
+    BasicLoopbackTransport *m_peer = nullptr;
+    std::deque<Message> m_inbox;
+    message_handler m_handler;
+    serialized_message_handler m_serializedHandler;
+    bool m_serialize = false;
+
+public:
+    BasicLoopbackTransport() = default;
+    BasicLoopbackTransport(const BasicLoopbackTransport &) = delete;
+    BasicLoopbackTransport &operator=(const BasicLoopbackTransport &) = delete;
+
+    /// @brief Connects @p a and @p b with each other
+    static void connect(BasicLoopbackTransport &a, BasicLoopbackTransport &b)
+    {
+        a.m_peer = &b;
+        b.m_peer = &a;
+    }
+
+    /// @brief Returns whether sent messages are serialized and parsed again
+    bool serialize() const { return m_serialize; }
+    /// @brief Round-trip every sent message through its JSON text representation, to include
+    ///        encoding costs in measurements
+    void set_serialize(bool enabled) { m_serialize = enabled; }
+
+    void send(const Json &s) override
+    {
+        if (!m_peer) {
+            std::cerr << "Loopback transport is not connected" << std::endl;
+            return;
+        }
+
+        if (m_serialize) {
+            m_peer->m_inbox.push_back(Message { s.dump(), Json() });
+        } else {
+            m_peer->m_inbox.push_back(Message { std::string(), s });
+        }
+    }
+
+    /// @brief With serialization enabled, serialized messages are queued as they are
+    bool accepts_serialized() const override { return m_serialize; }
+
+    void send_serialized(std::string &&message) override
+    {
+        if (!m_peer) {
+            std::cerr << "Loopback transport is not connected" << std::endl;
+            return;
+        }
+
+        m_peer->m_inbox.push_back(Message { std::move(message), Json() });
+    }
+
+    void register_message_handler(message_handler handler) override
+    {
+        m_handler = std::move(handler);
+    }
+
+    bool register_serialized_message_handler(serialized_message_handler handler) override
+    {
+        m_serializedHandler = std::move(handler);
+        return true;
+    }
+
+    /// @brief Returns the number of messages waiting to be delivered by `process()`
+    std::size_t pending() const { return m_inbox.size(); }
+
+    /// @brief Delivers the messages that are currently queued
+    /// @return The number of delivered messages
+    std::size_t process()
+    {
+        std::size_t count = m_inbox.size();
+        for (std::size_t i = 0; i < count; ++i) {
+            // move out first, the handler may cause new messages to be queued
+            Message msg = std::move(m_inbox.front());
+            m_inbox.pop_front();
+            if (msg.text.empty()) {
+                if (m_handler) {
+                    m_handler(msg.json);
+                }
+            } else if (m_serializedHandler) {
+                m_serializedHandler(msg.text.data(), msg.text.size());
+            } else if (m_handler) {
+                m_handler(Json::parse(msg.text));
+            }
+        }
+        return count;
+    }
+};
+
+/// @brief Two connected BasicLoopbackTransport instances, e.g. for a channel and a mock host
+template<class Json = nlohmann::json>
+struct BasicLoopbackPair
+{
+    BasicLoopbackTransport<Json> client;
+    BasicLoopbackTransport<Json> host;
+
+    BasicLoopbackPair()
+    {
+        BasicLoopbackTransport<Json>::connect(client, host);
+    }
+
+    /// @brief Delivers messages in both directions until none are left
+    /// @return The number of delivered messages
+    std::size_t run()
+    {
+        std::size_t count = 0;
+        for (;;) {
+            const std::size_t delivered = host.process() + client.process();
+            if (delivered == 0) {
+                return count;
+            }
+            count += delivered;
+        }
+    }
+};
+
+using LoopbackTransport = BasicLoopbackTransport<>;
+using LoopbackPair = BasicLoopbackPair<>;
+
+}
+
+#endif // LOOPBACK_TRANSPORT_H
@@ -0,0 +1,463 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef MESSAGE_DECODER_H
+#define MESSAGE_DECODER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "qwebchannel_fwd.h"
+
+namespace WebChannelPP
+{
+
+/// @brief Decodes incoming channel messages from JSON text with the SAX interface of
+///        nlohmann::json, without building a DOM of the whole message.
+///
+/// Routing fields (`type`, `id`, `object`, `signal`) are read while parsing. DOM subtrees are
+/// only built for payloads: signal arguments, response data and the values of property
+/// updates. Property updates of objects rejected by the object filter are skipped entirely.
+///
+/// Qt writes keys in alphabetical order, so the type of a message is only known at its end.
+/// `data` arrays are therefore decoded optimistically as property updates. If the message
+/// turns out to be something else, or lacks fields needed to handle it, `complete` is false
+/// and the caller has to parse it as a whole instead.
+template<class Json = nlohmann::json>
+class BasicMessageDecoder
+{
+public:
+    using json_t = Json;
+    using string_t = typename json_t::string_t;
+    using number_integer_t = typename json_t::number_integer_t;
+    using number_unsigned_t = typename json_t::number_unsigned_t;
+    using number_float_t = typename json_t::number_float_t;
+
+    /// @brief Returns whether property updates of @p object are of interest
+    typedef std::function<bool(const string_t &object)> ObjectFilter;
+
+    /// @brief One entry of the `data` array of a PropertyUpdate message
+    struct PropertyUpdate
+    {
+        string_t object;
+        json_t signals;
+        json_t properties;
+        /// The object was rejected by the filter, `signals` and `properties` were not decoded
+        bool skipped = false;
+    };
+
+    struct Message
+    {
+        /// The message type, or -1 if the message has none
+        int type = -1;
+        unsigned int id = 0;
+        bool hasId = false;
+        string_t object;
+        bool hasObject = false;
+        int signal = 0;
+        bool hasSignal = false;
+        json_t args;
+        bool hasArgs = false;
+        json_t data;
+        std::vector<PropertyUpdate> updates;
+        /// Whether the fields above suffice to handle the message
+        bool complete = false;
+    };
+
+private:
+    enum class Field
+    {
+        Other,
+        Args,
+        Data,
+        Id,
+        Object,
+        Properties,
+        Signal,
+        Signals,
+        Type,
+    };
+
+    Message m_message;
+    ObjectFilter m_filter;
+
+    // nesting of the routing structure: 1 = message, 2 = `data` array, 3 = update entry
+    int m_depth = 0;
+    Field m_field = Field::Other;
+    bool m_decodingUpdates = false;
+    bool m_syntaxError = false;
+
+    // number of open containers of a value that is skipped
+    std::size_t m_skip = 0;
+
+    // DOM subtree that is currently built, see capture()
+    json_t *m_captureRoot = nullptr;
+    std::vector<json_t*> m_captureStack;
+    json_t *m_captureElement = nullptr;
+
+public:
+    /// @brief Sets the filter for property updates. Without one, all updates are decoded.
+    void set_object_filter(ObjectFilter filter) { m_filter = std::move(filter); }
+
+    /// @brief Decodes the message in the @p size bytes at @p data
+    /// @return false if the input is not valid JSON
+    bool decode(const char *data, std::size_t size)
+    {
+        reset();
+        const bool parsed = json_t::sax_parse(data, data + size, this);
+        if (m_syntaxError) {
+            return false;
+        }
+
+        m_message.complete = parsed && is_complete();
+        return true;
+    }
+
+    /// @brief Returns the message decoded last. Payloads may be moved out of it.
+    Message &message() { return m_message; }
+
+    // SAX interface, see nlohmann::json_sax
+
+    bool null() { return value(nullptr); }
+    bool boolean(bool val) { return value(val); }
+    bool number_integer(number_integer_t val) { return value(val); }
+    bool number_unsigned(number_unsigned_t val) { return value(val); }
+    bool number_float(number_float_t val, const string_t &) { return value(val); }
+    bool string(string_t &val) { return value(std::move(val)); }
+
+    bool start_object(std::size_t)
+    {
+        if (m_skip > 0) {
+            ++m_skip;
+            return true;
+        }
+
+        if (capturing()) {
+            m_captureStack.push_back(add_captured(json_t::value_t::object));
+            return true;
+        }
+
+        switch (m_depth) {
+        case 0:
+            m_depth = 1;
+            return true;
+        case 2:
+            // an entry of a property update
+            m_message.updates.emplace_back();
+            m_depth = 3;
+            return true;
+        default:
+            break;
+        }
+
+        json_t *target = member_target();
+        if (!target) {
+            m_skip = 1;
+            return true;
+        }
+        capture(target);
+        m_captureStack.push_back(add_captured(json_t::value_t::object));
+        return true;
+    }
+
+    bool end_object()
+    {
+        if (m_skip > 0) {
+            --m_skip;
+            return true;
+        }
+
+        if (capturing()) {
+            end_captured();
+            return true;
+        }
+
+        // leaving a message (1 -> 0) or an update entry (3 -> 2)
+        --m_depth;
+        return true;
+    }
+
+    bool start_array(std::size_t)
+    {
+        if (m_skip > 0) {
+            ++m_skip;
+            return true;
+        }
+
+        if (capturing()) {
+            m_captureStack.push_back(add_captured(json_t::value_t::array));
+            return true;
+        }
+
+        if (m_depth == 0) {
+            // not a channel message
+            return false;
+        }
+
+        if (m_depth == 1 && m_field == Field::Data) {
+            m_decodingUpdates = true;
+            m_depth = 2;
+            return true;
+        }
+
+        json_t *target = m_depth == 2 ? nullptr : member_target();
+        if (!target) {
+            m_skip = 1;
+            return true;
+        }
+        capture(target);
+        m_captureStack.push_back(add_captured(json_t::value_t::array));
+        return true;
+    }
+
+    bool end_array()
+    {
+        if (m_skip > 0) {
+            --m_skip;
+            return true;
+        }
+
+        if (capturing()) {
+            end_captured();
+            return true;
+        }
+
+        // leaving the `data` array
+        m_depth = 1;
+        return true;
+    }
+
+    bool key(string_t &val)
+    {
+        if (m_skip > 0) {
+            return true;
+        }
+
+        if (capturing()) {
+            m_captureElement = &(*m_captureStack.back())[val];
+            return true;
+        }
+
+        m_field = field(val);
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &)
+    {
+        m_syntaxError = true;
+        return false;
+    }
+
+private:
+    void reset()
+    {
+        m_message.type = -1;
+        m_message.hasId = false;
+        m_message.object.clear();
+        m_message.hasObject = false;
+        m_message.hasSignal = false;
+        m_message.args = nullptr;
+        m_message.hasArgs = false;
+        m_message.data = nullptr;
+        m_message.updates.clear();
+        m_message.complete = false;
+
+        m_depth = 0;
+        m_field = Field::Other;
+        m_decodingUpdates = false;
+        m_syntaxError = false;
+        m_skip = 0;
+        m_captureRoot = nullptr;
+        m_captureStack.clear();
+        m_captureElement = nullptr;
+    }
+
+    bool is_complete() const
+    {
+        switch (m_message.type) {
+        case BasicQWebChannelMessageTypes::QSignal:
+            return m_message.hasObject && m_message.hasSignal && !m_decodingUpdates;
+        case BasicQWebChannelMessageTypes::Response:
+            return m_message.hasId && !m_decodingUpdates;
+        case BasicQWebChannelMessageTypes::PropertyUpdate:
+            return m_decodingUpdates;
+        default:
+            return false;
+        }
+    }
+
+    static Field field(const string_t &name)
+    {
+        if (name == "args") return Field::Args;
+        if (name == "data") return Field::Data;
+        if (name == "id") return Field::Id;
+        if (name == "object") return Field::Object;
+        if (name == "properties") return Field::Properties;
+        if (name == "signal") return Field::Signal;
+        if (name == "signals") return Field::Signals;
+        if (name == "type") return Field::Type;
+        return Field::Other;
+    }
+
+    // Returns the DOM a value of the current member is built into, or nullptr to skip it
+    json_t *member_target()
+    {
+        if (m_depth == 1) {
+            switch (m_field) {
+            case Field::Args:
+                m_message.hasArgs = true;
+                return &m_message.args;
+            case Field::Data:
+                return &m_message.data;
+            default:
+                return nullptr;
+            }
+        }
+
+        if (m_depth == 3) {
+            PropertyUpdate &update = m_message.updates.back();
+            if (update.skipped) {
+                return nullptr;
+            }
+            switch (m_field) {
+            case Field::Properties:
+                return &update.properties;
+            case Field::Signals:
+                return &update.signals;
+            default:
+                return nullptr;
+            }
+        }
+
+        return nullptr;
+    }
+
+    template<class Value>
+    bool value(Value &&val)
+    {
+        if (m_skip > 0) {
+            return true;
+        }
+
+        if (capturing()) {
+            add_captured(std::forward<Value>(val));
+            return true;
+        }
+
+        if (m_depth == 0) {
+            return false;
+        }
+
+        if (m_depth == 2) {
+            // property updates are objects, anything else is ignored
+            return true;
+        }
+
+        if (routing_value(val)) {
+            return true;
+        }
+
+        json_t *target = member_target();
+        if (target) {
+            *target = json_t(std::forward<Value>(val));
+        }
+        return true;
+    }
+
+    bool routing_value(const string_t &val)
+    {
+        if (m_depth == 1 && m_field == Field::Object) {
+            m_message.object = val;
+            m_message.hasObject = true;
+            return true;
+        }
+
+        if (m_depth == 3 && m_field == Field::Object) {
+            PropertyUpdate &update = m_message.updates.back();
+            update.object = val;
+            if (m_filter && !m_filter(update.object)) {
+                update.skipped = true;
+                update.signals = nullptr;
+                update.properties = nullptr;
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    bool routing_value(number_integer_t val) { return routing_number(val); }
+    bool routing_value(number_unsigned_t val) { return routing_number(val); }
+
+    template<class Value>
+    bool routing_value(const Value &) { return false; }
+
+    template<class Number>
+    bool routing_number(Number val)
+    {
+        if (m_depth != 1) {
+            return false;
+        }
+
+        switch (m_field) {
+        case Field::Type:
+            m_message.type = int(val);
+            return true;
+        case Field::Id:
+            m_message.id = static_cast<unsigned int>(val);
+            m_message.hasId = true;
+            return true;
+        case Field::Signal:
+            m_message.signal = int(val);
+            m_message.hasSignal = true;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool capturing() const { return !m_captureStack.empty(); }
+
+    void capture(json_t *root)
+    {
+        m_captureRoot = root;
+        m_captureElement = nullptr;
+    }
+
+    template<class Value>
+    json_t *add_captured(Value &&val)
+    {
+        if (m_captureStack.empty()) {
+            *m_captureRoot = json_t(std::forward<Value>(val));
+            return m_captureRoot;
+        }
+
+        json_t *parent = m_captureStack.back();
+        if (parent->is_array()) {
+            parent->push_back(json_t(std::forward<Value>(val)));
+            return &parent->back();
+        }
+
+        *m_captureElement = json_t(std::forward<Value>(val));
+        return m_captureElement;
+    }
+
+    void end_captured()
+    {
+        m_captureStack.pop_back();
+        if (m_captureStack.empty()) {
+            m_captureRoot = nullptr;
+        }
+    }
+};
+
+using MessageDecoder = BasicMessageDecoder<>;
+
+}
+
+#endif // MESSAGE_DECODER_H
@@ -0,0 +1,172 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef MESSAGE_WRITER_H
+#define MESSAGE_WRITER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "qwebchannel_fwd.h"
+#include "wire_format.h"
+
+namespace WebChannelPP
+{
+
+/// @brief Writes the messages sent by a channel as JSON text, without building a DOM first.
+///
+/// The outgoing messages of the protocol have a fixed shape, so only method arguments and
+/// property values go through the generic serializer. Keys are written in the same order
+/// as `nlohmann::json::dump()` would, so the output is identical to serializing the message
+/// object.
+template<class Json = nlohmann::json>
+class BasicMessageWriter
+{
+public:
+    using json_t = Json;
+    using string_t = typename json_t::string_t;
+
+private:
+    BasicMessageEncoder<json_t> m_encoder;
+
+public:
+    /// @brief Appends @p value
+    void write_value(std::string &out, const json_t &value)
+    {
+        m_encoder.encode(value, out);
+    }
+
+    /// @brief Appends a message consisting of its @p type only, e.g. Idle
+    void write_message(std::string &out, int type)
+    {
+        out += "{\"type\":";
+        write_integer(out, type);
+        out += '}';
+    }
+
+    /// @brief Appends a message consisting of its @p type and the response @p id, e.g. Init
+    void write_message(std::string &out, int type, unsigned int id)
+    {
+        out += "{\"id\":";
+        write_integer(out, id);
+        out += ",\"type\":";
+        write_integer(out, type);
+        out += '}';
+    }
+
+    /// @brief Appends an InvokeMethod message
+    void write_invoke(std::string &out, const string_t &object, int method, const std::vector<json_t> &args, unsigned int id)
+    {
+        out += "{\"args\":[";
+        for (std::size_t i = 0; i < args.size(); ++i) {
+            if (i > 0) {
+                out += ',';
+            }
+            write_value(out, args[i]);
+        }
+        out += "],\"id\":";
+        write_integer(out, id);
+        out += ",\"method\":";
+        write_integer(out, method);
+        out += ",\"object\":";
+        write_string(out, object);
+        out += ",\"type\":";
+        write_integer(out, BasicQWebChannelMessageTypes::InvokeMethod);
+        out += '}';
+    }
+
+    /// @brief Appends a SetProperty message
+    void write_set_property(std::string &out, const string_t &object, int property, const json_t &value)
+    {
+        out += "{\"object\":";
+        write_string(out, object);
+        out += ",\"property\":";
+        write_integer(out, property);
+        out += ",\"type\":";
+        write_integer(out, BasicQWebChannelMessageTypes::SetProperty);
+        out += ",\"value\":";
+        write_value(out, value);
+        out += '}';
+    }
+
+    /// @brief Appends a ConnectToSignal or DisconnectFromSignal message, depending on @p type
+    void write_signal_connection(std::string &out, int type, const string_t &object, int signal)
+    {
+        out += "{\"object\":";
+        write_string(out, object);
+        out += ",\"signal\":";
+        write_integer(out, signal);
+        out += ",\"type\":";
+        write_integer(out, type);
+        out += '}';
+    }
+
+    /// @brief Appends @p value as a quoted and escaped JSON string. UTF-8 is passed through.
+    static void write_string(std::string &out, const string_t &value)
+    {
+        static const char hex[] = "0123456789abcdef";
+
+        out += '"';
+
+        // copy runs of characters that need no escaping at once
+        const char *run = value.data();
+        const char *const end = value.data() + value.size();
+        for (const char *p = run; p != end; ++p) {
+            const unsigned char c = static_cast<unsigned char>(*p);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+
+            out.append(run, p);
+            run = p + 1;
+
+            switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+                break;
+            }
+        }
+        out.append(run, end);
+
+        out += '"';
+    }
+
+    /// @brief Appends @p value in decimal notation
+    static void write_integer(std::string &out, long long value)
+    {
+        char digits[24];
+        char *p = digits + sizeof(digits);
+
+        unsigned long long magnitude = value < 0 ? 0ULL - static_cast<unsigned long long>(value)
+                                                 : static_cast<unsigned long long>(value);
+        do {
+            *--p = char('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+
+        if (value < 0) {
+            *--p = '-';
+        }
+
+        out.append(p, digits + sizeof(digits));
+    }
+};
+
+using MessageWriter = BasicMessageWriter<>;
+
+}
+
+#endif // MESSAGE_WRITER_H
@@ -0,0 +1,348 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef MOCK_HOST_H
+#define MOCK_HOST_H
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "qwebchannel_fwd.h"
+
+namespace WebChannelPP
+{
+
+/// @brief Shape of the objects exported by a BasicMockHost
+struct MockHostConfig
+{
+    std::size_t objects = 1;
+    std::size_t methods = 4;
+    std::size_t properties = 4;
+    std::size_t signals = 2;
+};
+
+/// @brief Counters of the messages a BasicMockHost received and sent
+struct MockHostStats
+{
+    std::size_t invokes = 0;
+    std::size_t property_sets = 0;
+    std::size_t idles = 0;
+    std::size_t signals_emitted = 0;
+    std::size_t property_updates_sent = 0;
+};
+
+/// @brief Stand-in for a Qt application exporting objects through QWebChannel.
+///
+/// Speaks the host side of the protocol over any transport, without Qt. Objects are named
+/// `object0`, `object1`, ... and have methods `method0`, ..., properties `property0`, ...
+/// (with notify signals `property0Changed`, ...) and signals `signal0`, ...
+/// All property values start out as 0.
+///
+/// Like QWebChannel, property updates are buffered until the client reports to be idle.
+/// `tick()` emits signals and changes properties at the configured rates, which makes for
+/// deterministic load without timers.
+template<class Json = nlohmann::json>
+class BasicMockHost
+{
+public:
+    using json_t = Json;
+    using string_t = typename json_t::string_t;
+
+    /// @brief Computes the result of method @p method of object @p object called with @p args
+    typedef std::function<json_t(const string_t &object, int method, const json_t &args)> MethodHandler;
+
+private:
+    struct Object
+    {
+        string_t name;
+        std::vector<json_t> properties;
+        std::set<int> connectedSignals;
+    };
+
+    BasicTransport<json_t> &m_transport;
+    MockHostConfig m_config;
+    std::vector<Object> m_objects;
+    std::map<string_t, std::size_t> m_objectIndex;
+    MethodHandler m_methodHandler;
+
+    // object index -> property index -> value, sent once the client is idle
+    std::map<std::size_t, std::map<int, json_t>> m_pendingUpdates;
+    bool m_clientIdle = false;
+
+    std::size_t m_signalsPerTick = 0;
+    std::size_t m_propertyUpdatesPerTick = 0;
+    std::size_t m_nextSignal = 0;
+    std::size_t m_nextProperty = 0;
+
+    MockHostStats m_stats;
+
+public:
+    BasicMockHost(BasicTransport<json_t> &transport, MockHostConfig config = MockHostConfig())
+        : m_transport(transport), m_config(config)
+    {
+        m_objects.resize(m_config.objects);
+        for (std::size_t i = 0; i < m_objects.size(); ++i) {
+            m_objects[i].name = "object" + std::to_string(i);
+            m_objects[i].properties.assign(m_config.properties, json_t(0));
+            m_objectIndex[m_objects[i].name] = i;
+        }
+
+        m_transport.register_message_handler(std::bind(&BasicMockHost::message_handler, this, std::placeholders::_1));
+    }
+
+    const MockHostConfig &config() const { return m_config; }
+    const MockHostStats &stats() const { return m_stats; }
+
+    /// @brief Sets the handler computing method results. By default, methods return their first argument.
+    void set_method_handler(MethodHandler handler) { m_methodHandler = std::move(handler); }
+
+    /// @brief Sets how many signals each `tick()` emits, round-robin over all objects and signals
+    void set_signal_rate(std::size_t perTick) { m_signalsPerTick = perTick; }
+    /// @brief Sets how many property values each `tick()` changes, round-robin over all objects and properties
+    void set_property_update_rate(std::size_t perTick) { m_propertyUpdatesPerTick = perTick; }
+
+    /// @brief Emits signal @p signal of object @p object, if the client connected to it
+    void emit_signal(std::size_t object, int signal, const json_t &args = json_t::array())
+    {
+        if (!m_objects.at(object).connectedSignals.count(signal_index(signal))) {
+            return;
+        }
+
+        m_stats.signals_emitted++;
+        m_transport.send(json_t {
+            { "type", BasicQWebChannelMessageTypes::QSignal },
+            { "object", m_objects[object].name },
+            { "signal", signal_index(signal) },
+            { "args", args },
+        });
+    }
+
+    /// @brief Changes property @p property of object @p object. The client is notified once it is idle.
+    void set_property(std::size_t object, int property, const json_t &value)
+    {
+        m_objects.at(object).properties.at(property) = value;
+        m_pendingUpdates[object][property] = value;
+        flush_property_updates();
+    }
+
+    const json_t &property(std::size_t object, int property) const
+    {
+        return m_objects.at(object).properties.at(property);
+    }
+
+    /// @brief Emits signals and changes properties at the configured rates
+    void tick()
+    {
+        const std::size_t signalCount = m_objects.size() * m_config.signals;
+        for (std::size_t i = 0; i < m_signalsPerTick && signalCount > 0; ++i) {
+            const std::size_t n = m_nextSignal++ % signalCount;
+            emit_signal(n / m_config.signals, int(n % m_config.signals), json_t::array({ json_t(m_nextSignal) }));
+        }
+
+        const std::size_t propertyCount = m_objects.size() * m_config.properties;
+        for (std::size_t i = 0; i < m_propertyUpdatesPerTick && propertyCount > 0; ++i) {
+            const std::size_t n = m_nextProperty++ % propertyCount;
+            const std::size_t object = n / m_config.properties;
+            const int property = int(n % m_config.properties);
+            m_objects[object].properties[property] = json_t(m_nextProperty);
+            m_pendingUpdates[object][property] = m_objects[object].properties[property];
+        }
+
+        flush_property_updates();
+    }
+
+private:
+    // signals come first in the method index space, then the notify signals, then the methods
+    int signal_index(int signal) const { return signal; }
+    int notify_signal_index(int property) const { return int(m_config.signals) + property; }
+    int method_index(int method) const { return int(m_config.signals + m_config.properties) + method; }
+
+    json_t object_info(const Object &object) const
+    {
+        json_t methods = json_t::array();
+        for (std::size_t i = 0; i < m_config.methods; ++i) {
+            methods.push_back(json_t::array({ "method" + std::to_string(i), method_index(int(i)) }));
+        }
+
+        json_t signals = json_t::array();
+        for (std::size_t i = 0; i < m_config.signals; ++i) {
+            signals.push_back(json_t::array({ "signal" + std::to_string(i), signal_index(int(i)) }));
+        }
+
+        json_t properties = json_t::array();
+        for (std::size_t i = 0; i < m_config.properties; ++i) {
+            const string_t name = "property" + std::to_string(i);
+            properties.push_back(json_t::array({
+                int(i), name,
+                json_t::array({ name + "Changed", notify_signal_index(int(i)) }),
+                object.properties[i],
+            }));
+        }
+
+        return json_t {
+            { "methods", methods },
+            { "properties", properties },
+            { "signals", signals },
+            { "enums", json_t::object() },
+        };
+    }
+
+    void message_handler(const json_t &message)
+    {
+        switch (message["type"].template get<int>()) {
+        case BasicQWebChannelMessageTypes::Init:
+            handle_init(message);
+            break;
+        case BasicQWebChannelMessageTypes::Idle:
+            m_stats.idles++;
+            m_clientIdle = true;
+            flush_property_updates();
+            break;
+        case BasicQWebChannelMessageTypes::InvokeMethod:
+            handle_invoke(message);
+            break;
+        case BasicQWebChannelMessageTypes::SetProperty:
+            handle_set_property(message);
+            break;
+        case BasicQWebChannelMessageTypes::ConnectToSignal:
+        case BasicQWebChannelMessageTypes::DisconnectFromSignal:
+            handle_connection(message);
+            break;
+        case BasicQWebChannelMessageTypes::Debug:
+            break;
+        default:
+            std::cerr << "Mock host received invalid message: " << message << std::endl;
+            break;
+        }
+    }
+
+    void handle_init(const json_t &message)
+    {
+        json_t data = json_t::object();
+        for (const Object &object : m_objects) {
+            data[object.name] = object_info(object);
+        }
+        respond(message, data);
+    }
+
+    void handle_invoke(const json_t &message)
+    {
+        m_stats.invokes++;
+
+        const Object *object = find(message);
+        if (!object) {
+            return;
+        }
+
+        const int method = message["method"].template get<int>() - method_index(0);
+        const json_t &args = message.value("args", json_t::array());
+        if (m_methodHandler) {
+            respond(message, m_methodHandler(object->name, method, args));
+        } else {
+            respond(message, args.empty() ? json_t() : args[0]);
+        }
+    }
+
+    void handle_set_property(const json_t &message)
+    {
+        m_stats.property_sets++;
+
+        const Object *object = find(message);
+        if (!object) {
+            return;
+        }
+
+        const std::size_t index = m_objectIndex[object->name];
+        const int property = message["property"].template get<int>();
+        if (property < 0 || std::size_t(property) >= m_config.properties) {
+            std::cerr << "Mock host: unknown property " << property << std::endl;
+            return;
+        }
+        set_property(index, property, message["value"]);
+    }
+
+    void handle_connection(const json_t &message)
+    {
+        auto it = m_objectIndex.find(message["object"].template get<string_t>());
+        if (it == m_objectIndex.end()) {
+            return;
+        }
+
+        std::set<int> &connected = m_objects[it->second].connectedSignals;
+        const int signal = message["signal"].template get<int>();
+        if (message["type"].template get<int>() == BasicQWebChannelMessageTypes::ConnectToSignal) {
+            connected.insert(signal);
+        } else {
+            connected.erase(signal);
+        }
+    }
+
+    void flush_property_updates()
+    {
+        if (!m_clientIdle || m_pendingUpdates.empty()) {
+            return;
+        }
+
+        json_t data = json_t::array();
+        for (const auto &kv : m_pendingUpdates) {
+            json_t signals = json_t::object();
+            json_t properties = json_t::object();
+            for (const auto &prop : kv.second) {
+                const string_t key = std::to_string(prop.first);
+                properties[key] = prop.second;
+                signals[std::to_string(notify_signal_index(prop.first))] = json_t::array({ prop.second });
+            }
+            data.push_back(json_t {
+                { "object", m_objects[kv.first].name },
+                { "signals", signals },
+                { "properties", properties },
+            });
+        }
+        m_pendingUpdates.clear();
+
+        // the client is busy until it reports to be idle again
+        m_clientIdle = false;
+        m_stats.property_updates_sent++;
+        m_transport.send(json_t {
+            { "type", BasicQWebChannelMessageTypes::PropertyUpdate },
+            { "data", data },
+        });
+    }
+
+    const Object *find(const json_t &message) const
+    {
+        auto it = m_objectIndex.find(message["object"].template get<string_t>());
+        if (it == m_objectIndex.end()) {
+            std::cerr << "Mock host: unknown object " << message["object"] << std::endl;
+            return nullptr;
+        }
+        return &m_objects[it->second];
+    }
+
+    void respond(const json_t &request, const json_t &data)
+    {
+        if (!request.count("id")) {
+            return;
+        }
+
+        m_transport.send(json_t {
+            { "type", BasicQWebChannelMessageTypes::Response },
+            { "id", request["id"] },
+            { "data", data },
+        });
+    }
+};
+
+using MockHost = BasicMockHost<>;
+
+}
+
+#endif // MOCK_HOST_H
@@ -0,0 +1,94 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace WebChannelPP
+{
+
+/// @brief Unbounded lock-free queue with many producers and a single consumer.
+///
+/// `push()` may be called from any thread and is wait-free: a single atomic exchange links the
+/// new node. `pop()` must only be called from one thread at a time. A push that is still
+/// linking its node may briefly be invisible to `pop()`, even though later pushes are complete;
+/// the consumer then sees an empty queue and picks it up on the next call.
+///
+/// T must be default constructible, the queue keeps one placeholder node.
+template<class T>
+class MpscQueue
+{
+    struct Node
+    {
+        std::atomic<Node*> next { nullptr };
+        T value;
+
+        Node() = default;
+        explicit Node(T &&val) : value(std::move(val)) {}
+    };
+
+    // producers append behind m_head, the consumer reads after m_tail
+    alignas(64) std::atomic<Node*> m_head;
+    alignas(64) Node *m_tail;
+
+public:
+    MpscQueue()
+    {
+        Node *stub = new Node();
+        m_head.store(stub, std::memory_order_relaxed);
+        m_tail = stub;
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value)) {
+        }
+        delete m_tail;
+    }
+
+    /// @brief Appends @p value. Safe to call from any thread.
+    void push(T value)
+    {
+        Node *node = new Node(std::move(value));
+        Node *prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /// @brief Moves the oldest value to @p value
+    /// @return false if the queue is empty
+    bool pop(T &value)
+    {
+        Node *tail = m_tail;
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+
+        // next becomes the placeholder
+        value = std::move(next->value);
+        next->value = T();
+        m_tail = next;
+        delete tail;
+        return true;
+    }
+
+    /// @brief Returns whether the queue looks empty to the consumer. Only meaningful on its thread.
+    bool empty() const
+    {
+        return m_tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+};
+
+}
+
+#endif // MPSC_QUEUE_H
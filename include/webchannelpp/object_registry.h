@@ -0,0 +1,227 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef OBJECT_REGISTRY_H
+#define OBJECT_REGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace WebChannelPP
+{
+
+/// @brief Interns object names and maps them to values, e.g. the objects of a channel.
+///
+/// Each name is stored once and identified by a compact handle. Handles are found through an
+/// open-addressing hash table with linear probing, and lookups take the name as a pointer and
+/// a length, so a name decoded into any buffer can be looked up without constructing a string.
+/// `remove()` frees a name and its handle: the bucket becomes a tombstone, which lookups probe
+/// past and interning reuses, and the handle is reused for the next new name. Handles are thus
+/// only valid until their name is removed.
+template<class Value, class String = std::string>
+class ObjectRegistry
+{
+public:
+    typedef std::uint32_t Handle;
+    static constexpr Handle npos = ~Handle(0);
+
+private:
+    // marks a bucket whose name was removed
+    static constexpr Handle tombstone = npos - 1;
+    static constexpr std::size_t no_bucket = ~std::size_t(0);
+
+    struct Entry
+    {
+        String name;
+        std::uint64_t hash;
+        Value value;
+        bool live;
+    };
+
+    std::vector<Entry> m_entries;
+    // handles of removed names, reused before the entries grow
+    std::vector<Handle> m_free;
+    // handles by hash, npos marks an empty bucket
+    std::vector<Handle> m_index;
+    std::size_t m_mask;
+    // buckets that are not empty, including tombstones
+    std::size_t m_usedBuckets = 0;
+
+public:
+    /// @param capacity Number of names the table is sized for initially
+    explicit ObjectRegistry(std::size_t capacity = 16)
+    {
+        std::size_t buckets = 16;
+        while (buckets < 2 * capacity) {
+            buckets *= 2;
+        }
+        m_index.assign(buckets, npos);
+        m_mask = buckets - 1;
+        m_entries.reserve(capacity);
+    }
+
+    /// @brief Returns the handle of the @p size bytes at @p name, adding the name if it is new
+    Handle intern(const char *name, std::size_t size)
+    {
+        const std::uint64_t hash = hash_name(name, size);
+        std::size_t bucket = hash & m_mask;
+        std::size_t reusable = no_bucket;
+        for (; m_index[bucket] != npos; bucket = (bucket + 1) & m_mask) {
+            const Handle handle = m_index[bucket];
+            if (handle == tombstone) {
+                if (reusable == no_bucket) {
+                    reusable = bucket;
+                }
+            } else if (matches(m_entries[handle], hash, name, size)) {
+                return handle;
+            }
+        }
+
+        Handle handle;
+        if (!m_free.empty()) {
+            handle = m_free.back();
+            m_free.pop_back();
+            m_entries[handle] = Entry { String(name, size), hash, Value(), true };
+        } else {
+            handle = Handle(m_entries.size());
+            m_entries.push_back(Entry { String(name, size), hash, Value(), true });
+        }
+
+        if (reusable != no_bucket) {
+            m_index[reusable] = handle;
+            return handle;
+        }
+
+        // keep the load factor, tombstones included, at or below one half
+        if (2 * (m_usedBuckets + 1) > m_index.size()) {
+            rehash();
+        } else {
+            m_index[bucket] = handle;
+            ++m_usedBuckets;
+        }
+        return handle;
+    }
+
+    Handle intern(const String &name) { return intern(name.data(), name.size()); }
+
+    /// @brief Returns the handle of the @p size bytes at @p name, or npos if the name is not interned
+    Handle find(const char *name, std::size_t size) const
+    {
+        const std::size_t bucket = find_bucket(name, size);
+        return bucket == no_bucket ? npos : m_index[bucket];
+    }
+
+    Handle find(const String &name) const { return find(name.data(), name.size()); }
+
+    /// @brief Removes the name of @p handle and its value. The handle may be handed out again.
+    void remove(Handle handle)
+    {
+        Entry &entry = m_entries[handle];
+        if (!entry.live) {
+            return;
+        }
+
+        const std::size_t bucket = find_bucket(entry.name.data(), entry.name.size());
+        m_index[bucket] = tombstone;
+
+        entry.live = false;
+        String().swap(entry.name);
+        entry.value = Value();
+        m_free.push_back(handle);
+    }
+
+    /// @brief Returns the value for @p name, or `Value()` if there is none
+    Value get(const char *name, std::size_t size) const
+    {
+        const Handle handle = find(name, size);
+        return handle == npos ? Value() : m_entries[handle].value;
+    }
+
+    Value get(const String &name) const { return get(name.data(), name.size()); }
+
+    const Value &value(Handle handle) const { return m_entries[handle].value; }
+    void set_value(Handle handle, Value value) { m_entries[handle].value = std::move(value); }
+
+    const String &name(Handle handle) const { return m_entries[handle].name; }
+
+    /// @brief Returns the number of interned names
+    std::size_t size() const { return m_entries.size() - m_free.size(); }
+
+    /// @brief Returns the number of handles in use or ready for reuse
+    std::size_t handles() const { return m_entries.size(); }
+
+private:
+    // FNV-1a
+    static std::uint64_t hash_name(const char *name, std::size_t size)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (std::size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<unsigned char>(name[i]);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static bool matches(const Entry &entry, std::uint64_t hash, const char *name, std::size_t size)
+    {
+        return entry.hash == hash && entry.name.size() == size && std::memcmp(entry.name.data(), name, size) == 0;
+    }
+
+    // bucket holding the handle of a name, or no_bucket
+    std::size_t find_bucket(const char *name, std::size_t size) const
+    {
+        const std::uint64_t hash = hash_name(name, size);
+        for (std::size_t bucket = hash & m_mask; m_index[bucket] != npos; bucket = (bucket + 1) & m_mask) {
+            const Handle handle = m_index[bucket];
+            if (handle != tombstone && matches(m_entries[handle], hash, name, size)) {
+                return bucket;
+            }
+        }
+        return no_bucket;
+    }
+
+    // rebuilds the index without tombstones, doubling it if the live names need the room
+    void rehash()
+    {
+        const std::size_t live = size();
+        std::size_t buckets = m_index.size();
+        while (4 * live > buckets) {
+            buckets *= 2;
+        }
+
+        m_index.assign(buckets, npos);
+        m_mask = buckets - 1;
+        m_usedBuckets = live;
+
+        for (Handle handle = 0; handle < m_entries.size(); ++handle) {
+            if (!m_entries[handle].live) {
+                continue;
+            }
+            std::size_t bucket = m_entries[handle].hash & m_mask;
+            while (m_index[bucket] != npos) {
+                bucket = (bucket + 1) & m_mask;
+            }
+            m_index[bucket] = handle;
+        }
+    }
+};
+
+template<class Value, class String>
+constexpr typename ObjectRegistry<Value, String>::Handle ObjectRegistry<Value, String>::npos;
+
+template<class Value, class String>
+constexpr typename ObjectRegistry<Value, String>::Handle ObjectRegistry<Value, String>::tombstone;
+
+template<class Value, class String>
+constexpr std::size_t ObjectRegistry<Value, String>::no_bucket;
+
+}
+
+#endif // OBJECT_REGISTRY_H
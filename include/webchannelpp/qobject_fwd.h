@@ -9,7 +9,10 @@
 #ifndef QOBJECT_FWD_H
 #define QOBJECT_FWD_H
 
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <mutex>
 #include <set>
 #include <iostream>
 
@@ -19,6 +22,7 @@
 #include <json.hpp>
 #endif
 #include "qwebchannel_fwd.h"
+#include "future.h"
 
 namespace WebChannelPP
 {
@@ -41,19 +45,22 @@ class BasicQObject
     struct Connection {
         static unsigned int next_id()
         {
-            static unsigned int gid = 0;
-            gid++;
+            // shared by all channels, which may live on different threads
+            static std::atomic<unsigned int> gid { 0 };
+            unsigned int id = ++gid;
 
-            if (gid == 0) {
-                gid = 1;
+            if (id == 0) {
+                id = ++gid;
             }
 
-            return gid;
+            return id;
         }
 
         string_t signalName;
         unsigned int id;
         std::function<void(const std::vector<json_t> &args)> callback;
+        // runs on the thread of the channel even if a SignalDispatcher is set
+        bool direct;
     };
 
     static constexpr int PropertyChangedSignalId = -1;
@@ -124,6 +131,23 @@ public:
     bool invoke(const string_t &name, Args&& ...args);
     /// @brief Invokes a method `name` with specified arguments `args`. `callback` is invoked when the method call has finished.
     bool invoke(const string_t &name, std::vector<json_t> args, std::function<void(const json_t&)> callback = std::function<void(const json_t&)>());
+    /// @brief Invokes a method `name` with specified arguments `args`. `callback` is invoked with ExecStatus::Ok and the
+    ///        result when the method call has finished, or with ExecStatus::Timeout if there was no answer within `timeout`.
+    ///        A zero `timeout` disables the timeout.
+    bool invoke_with_timeout(const string_t &name, std::vector<json_t> args, std::function<void(ExecStatus, const json_t&)> callback,
+                             std::chrono::milliseconds timeout);
+    /// @brief Invokes a method `name` with specified arguments `args` and returns a future for its result.
+    ///        The channel's default timeout applies.
+    Future<json_t> invoke_async(const string_t &name, std::vector<json_t> args);
+    /// @brief Invokes a method `name` with specified arguments `args` and returns a future for its result,
+    ///        which fails with ExecStatus::Timeout if there was no answer within `timeout`.
+    Future<json_t> invoke_async(const string_t &name, std::vector<json_t> args, std::chrono::milliseconds timeout);
+    /// @brief Invokes a method `name` with specified arguments `args` from any thread. The call is made on the thread of the
+    ///        channel, see `BasicQWebChannel::submit()`, and `callback` is run by `executor` when it has finished. It gets
+    ///        ExecStatus::Failed if the method does not exist or the object was destroyed in the meantime.
+    void post_invoke(const string_t &name, std::vector<json_t> args,
+                     std::function<void(ExecStatus, const json_t&)> callback = std::function<void(ExecStatus, const json_t&)>(),
+                     Executor executor = Executor());
 
     /// @brief Connects `callback` to the signal `name`. `N` is the number of arguments.
     /// @return The connection id.
@@ -136,6 +160,10 @@ public:
     /// @brief Connects `callback` to the signal `name`.
     /// @return The connection id.
     unsigned int connect(const string_t &signalName, std::function<void(const std::vector<json_t> &)> callback);
+    /// @brief Connects `callback` to the signal `name`. It always runs on the thread of the channel, even if the channel
+    ///        has a SignalDispatcher.
+    /// @return The connection id.
+    unsigned int connect_direct(const string_t &signalName, std::function<void(const std::vector<json_t> &)> callback);
 
     /// @brief Breaks the connection with identifier `id`.
     bool disconnect(unsigned int id);
@@ -144,18 +172,29 @@ public:
     json_unwrap<json_t> property(const string_t &name) const;
     /// @brief Sets the value of property `name` to `value`
     void set_property(const string_t &name, const json_t &value);
+    /// @brief Sets the value of property `name` to `value` from any thread, see `post_invoke()`
+    void post_set_property(const string_t &name, json_t value);
 
     string_t id() const { return __id__; }
 
 private:
     BasicQObject(const string_t &name, const json_t &data, BasicQWebChannel<json_t> *channel);
+    // An object that is neither known to the channel nor filled yet, see load() and attach()
+    BasicQObject(const string_t &name, BasicQWebChannel<json_t> *channel);
+
+    // Fills in methods, properties, signals and enums. Touches nothing but the object itself.
+    void load(const json_t &data);
+    // Makes the object known to the channel and to convert()
+    void attach();
 
     static std::set<BasicQObject*> &created_objects();
+    static std::mutex &created_objects_mutex();
 
     static BasicQObject *convert(std::uintptr_t ptr);
 
     template<class Callable, size_t... I>
     unsigned int connect_impl(const string_t &signal, Callable &&callable, std::index_sequence<I...>);
+    unsigned int add_connection(const string_t &signalName, std::function<void(const std::vector<json_t> &)> callback, bool direct);
 
     void addMethod(const json_t &method);
     void bindGetterSetter(const json_t &propertyInfo);
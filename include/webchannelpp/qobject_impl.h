@@ -37,14 +37,37 @@ bool isDestroyedSignal(const T &signalName)
 }
 }
 
+template<class Json>
+constexpr int BasicQObject<Json>::PropertyChangedSignalId;
+
 template<class Json>
 inline BasicQObject<Json>::BasicQObject(const string_t &name, const json_t &data, BasicQWebChannel<json_t> *channel)
+    : BasicQObject(name, channel)
+{
+    attach();
+    load(data);
+}
+
+template<class Json>
+inline BasicQObject<Json>::BasicQObject(const string_t &name, BasicQWebChannel<json_t> *channel)
     : __id__(name), _webChannel(channel)
 {
-    created_objects().insert(this);
+}
 
-    _webChannel->_objects[name] = this;
+template<class Json>
+inline void BasicQObject<Json>::attach()
+{
+    {
+        std::lock_guard<std::mutex> lock(created_objects_mutex());
+        created_objects().insert(this);
+    }
+
+    _webChannel->register_object(this);
+}
 
+template<class Json>
+inline void BasicQObject<Json>::load(const json_t &data)
+{
     if (data.count("methods")) {
         for (const json_t &method : data["methods"]) {
             addMethod(method);
@@ -72,6 +95,7 @@ inline BasicQObject<Json>::BasicQObject(const string_t &name, const json_t &data
 template<class Json>
 inline BasicQObject<Json>::~BasicQObject()
 {
+    std::lock_guard<std::mutex> lock(created_objects_mutex());
     created_objects().erase(this);
 }
 
@@ -137,9 +161,18 @@ inline std::set<BasicQObject<Json> *> &BasicQObject<Json>::created_objects() {
     return set;
 }
 
+// The registry is shared by all channels, but only touched when objects are created,
+// destroyed or converted from json, which is rare compared to routing messages.
+template<class Json>
+inline std::mutex &BasicQObject<Json>::created_objects_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
 template<class Json>
 inline BasicQObject<Json> *BasicQObject<Json>::convert(uintptr_t ptr) {
     BasicQObject *obj = reinterpret_cast<BasicQObject*>(ptr);
+    std::lock_guard<std::mutex> lock(created_objects_mutex());
     if (created_objects().find(obj) == created_objects().end()) {
         return nullptr;
     }
@@ -216,9 +249,9 @@ inline Json BasicQObject<Json>::unwrapQObject(const json_t &response) {
 
     const string_t objectId = response["id"];
 
-    auto it = _webChannel->_objects.find(objectId);
-    if (it != _webChannel->_objects.end()) {
-        return it->second;
+    BasicQObject *existing = _webChannel->object(objectId);
+    if (existing) {
+        return existing;
     }
 
     if (!response.count("data")) {
@@ -228,10 +261,11 @@ inline Json BasicQObject<Json>::unwrapQObject(const json_t &response) {
 
     BasicQObject *qObject = new BasicQObject( objectId, response["data"], _webChannel );
 
-    qObject->connect("destroyed", [qObject]() {
-        auto it = qObject->_webChannel->_objects.find(qObject->id());
-        if (it != qObject->_webChannel->_objects.end()) {
-            qObject->_webChannel->_objects.erase(it);
+    // direct, so that the object is unregistered on the thread of the channel and the flag is set
+    // before invokeSignalCallbacks() checks it, even with a SignalDispatcher
+    qObject->connect_direct("destroyed", [qObject](const std::vector<json_t> &) {
+        if (qObject->_webChannel->object(qObject->id()) == qObject) {
+            qObject->_webChannel->unregister_object(qObject->id());
 
             // Toggle this flag to ensure that all signal handlers have been run
             // before we destroy the instance. Actual destruction happens in
@@ -294,6 +328,17 @@ inline bool BasicQObject<Json>::invoke(const string_t &name, Args&& ...args)
 
 template<class Json>
 inline bool BasicQObject<Json>::invoke(const string_t &name, std::vector<json_t> args, std::function<void (const json_t &)> callback)
+{
+    return invoke_with_timeout(name, std::move(args), [callback](ExecStatus status, const json_t &result) {
+        if (status == ExecStatus::Ok && callback) {
+            callback(result);
+        }
+    }, _webChannel->default_timeout());
+}
+
+template<class Json>
+inline bool BasicQObject<Json>::invoke_with_timeout(const string_t &name, std::vector<json_t> args, std::function<void (ExecStatus, const json_t &)> callback,
+                                                    std::chrono::milliseconds timeout)
 {
     auto it = _methods.find(name);
     if (it == _methods.end()) {
@@ -309,23 +354,91 @@ inline bool BasicQObject<Json>::invoke(const string_t &name, std::vector<json_t>
         }
     }
 
-    json_t msg {
-        { "type", BasicQWebChannelMessageTypes::InvokeMethod },
-        { "method", methodIdx },
-        { "args", args },
-        { "object", __id__ },
-    };
+    _webChannel->invoke_method(__id__, methodIdx, args, [this, callback](ExecStatus status, const json_t &response) {
+        if (status != ExecStatus::Ok) {
+            if (callback) {
+                callback(status, response);
+            }
+            return;
+        }
 
-    _webChannel->exec(msg, [this, callback](const json_t &response) {
         json_t result = unwrapQObject(response);
         if (callback) {
-            callback(result);
+            callback(status, result);
         }
-    });
+    }, timeout);
 
     return true;
 }
 
+template<class Json>
+inline Future<Json> BasicQObject<Json>::invoke_async(const string_t &name, std::vector<json_t> args)
+{
+    return invoke_async(name, std::move(args), _webChannel->default_timeout());
+}
+
+template<class Json>
+inline Future<Json> BasicQObject<Json>::invoke_async(const string_t &name, std::vector<json_t> args, std::chrono::milliseconds timeout)
+{
+    Promise<json_t> promise;
+    Future<json_t> future = promise.get_future();
+
+    const bool sent = invoke_with_timeout(name, std::move(args), [promise](ExecStatus status, const json_t &result) mutable {
+        if (status == ExecStatus::Ok) {
+            promise.set_value(result);
+        } else {
+            promise.set_status(status);
+        }
+    }, timeout);
+
+    if (!sent) {
+        promise.set_status(ExecStatus::Failed);
+    }
+    return future;
+}
+
+template<class Json>
+inline void BasicQObject<Json>::post_invoke(const string_t &name, std::vector<json_t> args,
+                                            std::function<void(ExecStatus, const json_t&)> callback, Executor executor)
+{
+    auto complete = [callback, executor](ExecStatus status, const json_t &result) {
+        if (!callback) {
+            return;
+        }
+        if (!executor) {
+            callback(status, result);
+            return;
+        }
+        executor([callback, status, result]() { callback(status, result); });
+    };
+
+    // the object may be gone when the task runs, so it is looked up again by its id
+    BasicQWebChannel<json_t> *channel = _webChannel;
+    _webChannel->submit([channel, id = __id__, name, args = std::move(args), complete]() mutable {
+        BasicQObject *object = channel->object(id);
+        if (!object) {
+            complete(ExecStatus::Failed, json_t());
+            return;
+        }
+
+        if (!object->invoke_with_timeout(name, std::move(args), complete, channel->default_timeout())) {
+            complete(ExecStatus::Failed, json_t());
+        }
+    });
+}
+
+template<class Json>
+inline void BasicQObject<Json>::post_set_property(const string_t &name, json_t value)
+{
+    BasicQWebChannel<json_t> *channel = _webChannel;
+    _webChannel->submit([channel, id = __id__, name, value = std::move(value)]() {
+        BasicQObject *object = channel->object(id);
+        if (object) {
+            object->set_property(name, value);
+        }
+    });
+}
+
 template<class Json>
 inline void BasicQObject<Json>::propertyUpdate(const json_t &sigs, const json_t &propertyMap)
 {
@@ -365,12 +478,46 @@ inline void BasicQObject<Json>::invokeSignalCallbacks(int signalName, const std:
         connections.push_back(it->second);
     }
 
-    for (const auto &conn : connections) {
-        conn.callback(args);
+    SignalDispatcher *dispatcher = _webChannel->signal_dispatcher();
+    std::size_t key = 0;
+    bool posted = false;
+    if (!dispatcher) {
+        for (const auto &conn : connections) {
+            conn.callback(args);
+        }
+    } else {
+        // all callbacks of an emission go into one task, which keeps them in order
+        std::vector<std::function<void(const std::vector<json_t> &)>> callbacks;
+        for (const auto &conn : connections) {
+            if (conn.direct) {
+                conn.callback(args);
+            } else {
+                callbacks.push_back(conn.callback);
+            }
+        }
+
+        if (!callbacks.empty()) {
+            key = std::hash<string_t>()(__id__);
+            if (_webChannel->_signalOrder == SignalOrder::PerSignal) {
+                key = key * 31 + std::hash<int>()(signalName);
+            }
+
+            dispatcher->post(key, [callbacks, args]() {
+                for (const auto &callback : callbacks) {
+                    callback(args);
+                }
+            });
+            posted = true;
+        }
     }
 
     if (_destroyAfterSignal) {
-        delete this;
+        if (posted) {
+            // the callbacks posted above may still use the object, so it goes after them
+            dispatcher->post(key, [this]() { delete this; });
+        } else {
+            delete this;
+        }
     }
 }
 
@@ -409,14 +556,7 @@ inline void BasicQObject<Json>::set_property(const string_t &name, const json_t
         sendval = { { "id", sendval.template get<BasicQObject::Ptr>()->id() } };
     }
 
-    json_t msg {
-        { "type", BasicQWebChannelMessageTypes::SetProperty },
-        { "property", it->second },
-        { "value", sendval },
-        { "object", __id__ },
-    };
-
-    _webChannel->exec(msg);
+    _webChannel->set_object_property(__id__, it->second, sendval);
 }
 
 template<class Json>
@@ -446,6 +586,19 @@ unsigned int BasicQObject<Json>::connect_impl(const string_t &signalName, Callab
 
 template<class Json>
 inline unsigned int BasicQObject<Json>::connect(const string_t &signalName, std::function<void (const std::vector<json_t> &)> callback)
+{
+    return add_connection(signalName, std::move(callback), false);
+}
+
+template<class Json>
+inline unsigned int BasicQObject<Json>::connect_direct(const string_t &signalName, std::function<void (const std::vector<json_t> &)> callback)
+{
+    return add_connection(signalName, std::move(callback), true);
+}
+
+template<class Json>
+inline unsigned int BasicQObject<Json>::add_connection(const string_t &signalName, std::function<void (const std::vector<json_t> &)> callback,
+                                                      bool direct)
 {
     auto it = _qsignals.find(signalName);
     if (it == _qsignals.end()) {
@@ -459,7 +612,8 @@ inline unsigned int BasicQObject<Json>::connect(const string_t &signalName, std:
     BasicQObject<Json>::Connection conn {
         signalName,
         BasicQObject<Json>::Connection::next_id(),
-        callback
+        std::move(callback),
+        direct
     };
 
     __objectSignals__.insert(std::make_pair(signalIndex, conn));
@@ -467,13 +621,7 @@ inline unsigned int BasicQObject<Json>::connect(const string_t &signalName, std:
     if (!isPropertyNotifySignal && !detail::isDestroyedSignal<string_t>(signalName)) {
         // only required for "pure" signals, handled separately for properties in _propertyUpdate
         // also note that we always get notified about the destroyed signal
-        json_t msg {
-            { "type", BasicQWebChannelMessageTypes::ConnectToSignal },
-            { "object", __id__ },
-            { "signal", signalIndex },
-        };
-
-        _webChannel->exec(msg);
+        _webChannel->signal_connection(BasicQWebChannelMessageTypes::ConnectToSignal, __id__, signalIndex);
     }
 
     return conn.id;
@@ -505,11 +653,7 @@ inline bool BasicQObject<Json>::disconnect(unsigned int id)
 
     if (!sig.isPropertyNotifySignal && __objectSignals__.count(sig.signalIndex) == 0) {
         // only required for "pure" signals, handled separately for properties in propertyUpdate
-        _webChannel->exec(json_t {
-            { "type", BasicQWebChannelMessageTypes::DisconnectFromSignal },
-            { "object", __id__ },
-            { "signal", sig.signalIndex },
-        });
+        _webChannel->signal_connection(BasicQWebChannelMessageTypes::DisconnectFromSignal, __id__, sig.signalIndex);
     }
 
     return true;
@@ -9,9 +9,14 @@
 #ifndef QWEBCHANNEL_FWD_H
 #define QWEBCHANNEL_FWD_H
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <string>
+#include <vector>
 
 #ifndef WEBCHANNELPP_USE_GLOBAL_JSON
 #include "nlohmann/json.hpp"
@@ -19,6 +24,12 @@
 #include <json.hpp>
 #endif
 
+#include "callback_table.h"
+#include "mpsc_queue.h"
+#include "object_registry.h"
+#include "signal_dispatcher.h"
+#include "timer_wheel.h"
+
 namespace WebChannelPP
 {
 
@@ -26,14 +37,47 @@ namespace WebChannelPP
 ///
 /// The transport calls the registered message handle when a new message arives.
 /// `send` sends a message over the transport.
+///
+/// Transports that put JSON text on the wire can additionally accept messages that are
+/// already serialized, see `accepts_serialized()`, and deliver incoming messages before
+/// they are parsed, see `register_serialized_message_handler()`.
 template<class Json = nlohmann::json>
 class BasicTransport
 {
 public:
     typedef std::function<void(const Json &)> message_handler;
+    /// @brief Receives a message as JSON text. The data is only valid during the call.
+    typedef std::function<void(const char *data, std::size_t size)> serialized_message_handler;
 
     virtual void send(const Json &s) = 0;
     virtual void register_message_handler(message_handler handler) = 0;
+
+    /// @brief Registers @p handler to receive incoming messages as JSON text, so that the
+    ///        receiver can decode them itself. Messages the transport cannot deliver as JSON
+    ///        text (e.g. with a binary wire format) still go to the regular message handler.
+    /// @return false if the transport does not support this; the default
+    virtual bool register_serialized_message_handler(serialized_message_handler handler)
+    {
+        (void) handler;
+        return false;
+    }
+
+    /// @brief Returns whether `send_serialized()` is cheaper than `send()`, i.e. whether the
+    ///        transport can send JSON text without parsing it again
+    virtual bool accepts_serialized() const { return false; }
+
+    /// @brief Sends @p message, a single JSON message in compact text form (without line breaks).
+    ///
+    /// The transport takes ownership of the buffer, so it can be queued without copying.
+    /// By default, the message is parsed and passed to `send()`.
+    virtual void send_serialized(std::string &&message)
+    {
+        send(Json::parse(message));
+    }
+
+    /// @brief Returns an empty buffer to serialize a message into before passing it to
+    ///        `send_serialized()`. Transports recycle the buffers of sent messages here.
+    virtual std::string acquire_buffer() { return std::string(); }
 };
 
 /// @brief Thin helper class for implicitly converting json data types
@@ -68,9 +112,29 @@ enum BasicQWebChannelMessageTypes {
     Response = 10,
 };
 
+/// @brief Outcome of a request to the host
+enum class ExecStatus {
+    /// The host answered
+    Ok,
+    /// The host did not answer in time
+    Timeout,
+    /// The request could not be sent, e.g. because the method does not exist
+    Failed,
+};
+
+/// @brief Runs a completion on behalf of the caller, e.g. by posting it to the caller's event loop.
+///        An empty executor runs completions on the thread of the channel.
+typedef std::function<void(std::function<void()>)> Executor;
+
 template<class Json>
 class BasicQObject;
 
+template<class Json>
+class BasicMessageWriter;
+
+template<class Json>
+class BasicMessageDecoder;
+
 template<class Json = nlohmann::json>
 class BasicQWebChannel
 {
@@ -80,17 +144,40 @@ public:
 
     typedef std::function<void(BasicQWebChannel*)> InitCallbackHandler;
     typedef std::function<void(const json_t &)> CallbackHandler;
+    typedef std::function<void(ExecStatus, const json_t &)> StatusCallbackHandler;
 
     /// @brief Initializes the webchannel with the given `transport`. Optionally, an `initCallback`
     ///        can be invoked when the webchannel has successfully been initialized.
     BasicQWebChannel(BasicTransport<json_t> &transport, InitCallbackHandler initCallback = InitCallbackHandler());
 
-    /// @brief Returns a map of all objects exported by the webchannel
-    const std::map<string_t, BasicQObject<json_t>*> &objects() const { return _objects; }
+    /// @brief Returns whether the objects of the host are known, i.e. whether the initCallback ran
+    bool initialized() const { return _initialized; }
+    /// @brief Calls @p callback once the webchannel is initialized, right away if it already is
+    void when_initialized(InitCallbackHandler callback);
+
+    /// @brief Returns a map of all objects exported by the webchannel. With lazy objects, this builds all of them.
+    const std::map<string_t, BasicQObject<json_t>*> &objects() const;
 
     /// @brief Returns the object with @p name or nullptr if it doesn't exist
     BasicQObject<json_t> *object(const string_t &name) const;
 
+    /// @brief Returns whether objects are only built when they are first used
+    bool lazy_objects() const { return _lazyObjects; }
+    /// @brief Enables or disables lazy objects. Set it before the webchannel is initialized.
+    ///
+    /// Lazy objects are kept as the metadata the host sent with the Init response. An object is built on
+    /// its first `object()` call, when a message for it arrives, or when another object refers to it.
+    void set_lazy_objects(bool enabled) { _lazyObjects = enabled; }
+
+    /// @brief Returns the number of threads that build the objects of the Init response
+    std::size_t init_threads() const { return _initThreads; }
+    /// @brief Builds the objects of the Init response on up to @p threads threads. Set it before the webchannel is initialized.
+    ///
+    /// Only the metadata of each object is built in parallel. Linking objects that refer to each other and calling the
+    /// initCallback happen afterwards on the thread of the channel, in the same order as with a single thread. This has
+    /// no effect with lazy objects.
+    void set_init_threads(std::size_t threads) { _initThreads = threads; }
+
     /// @brief Returns whether property caching is enabled
     bool property_caching() const { return propertyCachingEnabled; }
 
@@ -104,17 +191,96 @@ public:
     /// @brief Explicitly notify the host that the client is idle
     void idle();
 
+    /// @brief Returns the timeout of requests that don't specify one. Zero means no timeout.
+    std::chrono::milliseconds default_timeout() const { return _defaultTimeout; }
+    /// @brief Sets the time after which requests the host did not answer are given up.
+    ///        Callbacks that take an ExecStatus are then called with ExecStatus::Timeout,
+    ///        plain callbacks are dropped.
+    void set_default_timeout(std::chrono::milliseconds timeout) { _defaultTimeout = timeout; }
+
+    /// @brief Gives up all requests whose timeout expired.
+    ///
+    /// This happens for every incoming message. While the host is silent, call it
+    /// periodically, e.g. from a timer.
+    /// @return The number of requests that timed out
+    std::size_t process_timeouts();
+
+    /// @brief Returns the number of requests waiting for an answer
+    std::size_t pending_requests() const { return execCallbacks.size(); }
+
+    /// @brief Queues @p task to be run on the thread of the channel. Safe to call from any thread.
+    ///
+    /// Everything else in the channel and its objects must only be used from the thread driving the
+    /// transport; other threads hand work over with this, e.g. `BasicQObject::post_invoke()`.
+    void submit(std::function<void()> task);
+
+    /// @brief Sets the function called by `submit()` when the queue of submitted tasks was empty.
+    ///
+    /// It runs on the submitting thread and should make the thread of the channel call
+    /// `process_submissions()`, e.g. by posting to its event loop. Set it before other threads
+    /// start submitting.
+    void set_submission_notifier(std::function<void()> notifier) { submissionNotifier = std::move(notifier); }
+
+    /// @brief Runs the tasks queued by `submit()`, in the order they were submitted.
+    ///
+    /// This also happens for every incoming message. Without a notifier, call it periodically.
+    /// @return The number of tasks run
+    std::size_t process_submissions();
+
+    /// @brief Returns the dispatcher running signal callbacks, or nullptr if they run on the thread of the channel
+    SignalDispatcher *signal_dispatcher() const { return _signalDispatcher; }
+    /// @brief Runs signal callbacks on the threads of @p dispatcher, ordered by @p order, instead of the thread
+    ///        of the channel. nullptr restores running them inline.
+    ///
+    /// Such callbacks only get the signal arguments; they must not use the channel or its objects other than
+    /// through `submit()`, `post_invoke()` and `post_set_property()`. Connections made with `connect_direct()`
+    /// still run inline. While the dispatcher is full, the channel blocks and stops reading messages.
+    void set_signal_dispatcher(SignalDispatcher *dispatcher, SignalOrder order = SignalOrder::PerObject)
+    {
+        _signalDispatcher = dispatcher;
+        _signalOrder = order;
+    }
+
 private:
     void connection_made(const json_t &data);
+    void build_objects_parallel(const json_t &data);
     void message_handler(const json_t &msg);
+    void serialized_message_handler(const char *data, std::size_t size);
 
     void send(const json_t &o);
     void exec(json_t data, CallbackHandler callback = CallbackHandler());
+    unsigned int add_callback(StatusCallbackHandler callback, std::chrono::milliseconds timeout);
+
+    // the messages sent by objects, written without building a DOM if the transport accepts text
+    void invoke_method(const string_t &object, int method, const std::vector<json_t> &args,
+                       StatusCallbackHandler callback, std::chrono::milliseconds timeout);
+    void set_object_property(const string_t &object, int property, const json_t &value);
+    void signal_connection(int type, const string_t &object, int signal);
 
     void handle_signal(const json_t &message);
     void handle_response(const json_t &message);
     void handle_property_update(const json_t &message);
 
+    void handle_signal(const string_t &object, int signal, const json_t &args);
+    void handle_response(unsigned int id, const json_t &data);
+    void handle_response(unsigned int id, json_t &&data);
+    void handle_property_update(const string_t &object, const json_t &signals, const json_t &properties);
+
+    // An object, or the Init metadata of a lazy object that was not built yet
+    struct ObjectSlot
+    {
+        BasicQObject<json_t> *object = nullptr;
+        const json_t *metadata = nullptr;
+    };
+
+    // _objects and the registry always hold the same objects; routing only uses the registry
+    void register_object(BasicQObject<json_t> *object);
+    void unregister_object(const string_t &name);
+    bool knows_object(const char *name, std::size_t size) const;
+    BasicQObject<json_t> *find_object(const char *name, std::size_t size);
+    BasicQObject<json_t> *materialize(typename ObjectRegistry<ObjectSlot, string_t>::Handle handle);
+    void materialize_all();
+
     void debug(const json_t &message)
     {
         this->send(json_t { { "type", BasicQWebChannelMessageTypes::Debug }, { "data", message } });
@@ -123,14 +289,32 @@ private:
     friend class BasicQObject<json_t>;
 
     BasicTransport<json_t> &transport;
+    BasicMessageWriter<json_t> writer;
+    BasicMessageDecoder<json_t> decoder;
 
     std::map<string_t, BasicQObject<json_t>*> _objects;
+    ObjectRegistry<ObjectSlot, string_t> registry;
+    // the Init data of lazy objects that were not built yet
+    json_t lazyMetadata;
+    unsigned int _initRequestId = 0;
+    bool _lazyObjects = false;
+    std::size_t _initThreads = 1;
 
     InitCallbackHandler initCallback;
-    std::map<unsigned int, CallbackHandler> execCallbacks;
-    unsigned int execId = 0;
+    std::vector<InitCallbackHandler> initWaiters;
+    bool _initialized = false;
+    CallbackTable<StatusCallbackHandler> execCallbacks;
+    TimerWheel<unsigned int> timeouts;
+    std::chrono::milliseconds _defaultTimeout { 0 };
     bool propertyCachingEnabled = true;
     bool _autoIdle = true;
+
+    MpscQueue<std::function<void()>> submissions;
+    std::atomic<bool> submissionsPending { false };
+    std::function<void()> submissionNotifier;
+
+    SignalDispatcher *_signalDispatcher = nullptr;
+    SignalOrder _signalOrder = SignalOrder::PerObject;
 };
 
 using Transport = BasicTransport<>;
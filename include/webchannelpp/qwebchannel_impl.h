@@ -9,8 +9,14 @@
 #ifndef QWEBCHANNEL_IMPL_H
 #define QWEBCHANNEL_IMPL_H
 
+#include <algorithm>
+#include <exception>
+#include <thread>
+
 #include "qwebchannel_fwd.h"
 #include "qobject_fwd.h"
+#include "message_decoder.h"
+#include "message_writer.h"
 
 namespace WebChannelPP
 {
@@ -19,10 +25,23 @@ template<class Json>
 inline BasicQWebChannel<Json>::BasicQWebChannel(BasicTransport<json_t> &transport, InitCallbackHandler initCallback)
     : transport(transport), initCallback(initCallback)
 {
-    transport.register_message_handler(std::bind(&BasicQWebChannel::message_handler, this, std::placeholders::_1));
+    using namespace std::placeholders;
+
+    // updates of objects we don't know about are not even decoded
+    decoder.set_object_filter([this](const string_t &name) {
+        return knows_object(name.data(), name.size());
+    });
 
-    this->exec(json_t { { "type", BasicQWebChannelMessageTypes::Init } },
-               std::bind(&BasicQWebChannel::connection_made, this, std::placeholders::_1));
+    transport.register_message_handler(std::bind(&BasicQWebChannel::message_handler, this, _1));
+    transport.register_serialized_message_handler(std::bind(&BasicQWebChannel::serialized_message_handler, this, _1, _2));
+
+    // like exec(), but the id is remembered so lazy objects can take over the response
+    _initRequestId = add_callback([this](ExecStatus status, const json_t &data) {
+        if (status == ExecStatus::Ok) {
+            connection_made(data);
+        }
+    }, _defaultTimeout);
+    this->send(json_t { { "type", BasicQWebChannelMessageTypes::Init }, { "id", _initRequestId } });
 }
 
 template<class Json>
@@ -41,51 +60,255 @@ inline void BasicQWebChannel<Json>::set_auto_idle(bool enabled)
 template<class Json>
 inline void BasicQWebChannel<Json>::idle()
 {
-    this->exec(json_t { { "type", BasicQWebChannelMessageTypes::Idle } } );
+    if (!transport.accepts_serialized()) {
+        this->exec(json_t { { "type", BasicQWebChannelMessageTypes::Idle } } );
+        return;
+    }
+
+    std::string buffer = transport.acquire_buffer();
+    writer.write_message(buffer, BasicQWebChannelMessageTypes::Idle);
+    transport.send_serialized(std::move(buffer));
 }
 
 template<class Json>
 inline void BasicQWebChannel<Json>::connection_made(const json_t &data)
 {
-    for (auto prop = data.begin(); prop != data.end(); ++prop) {
-        new BasicQObject<json_t>(prop.key(), prop.value(), this);
-    }
+    if (_lazyObjects) {
+        // only remember where the metadata of each object is. Decoded responses were moved
+        // into lazyMetadata already, see handle_response().
+        if (&data != &lazyMetadata) {
+            lazyMetadata = data;
+        }
+        for (auto prop = lazyMetadata.begin(); prop != lazyMetadata.end(); ++prop) {
+            const auto handle = registry.intern(prop.key());
+            ObjectSlot slot = registry.value(handle);
+            if (!slot.object) {
+                slot.metadata = &prop.value();
+                registry.set_value(handle, slot);
+            }
+        }
+    } else {
+        if (_initThreads > 1) {
+            build_objects_parallel(data);
+        } else {
+            for (auto prop = data.begin(); prop != data.end(); ++prop) {
+                new BasicQObject<json_t>(prop.key(), prop.value(), this);
+            }
+        }
 
-    // now unwrap properties, which might reference other registered objects
-    for (const auto &kv : _objects) {
-        kv.second->unwrapProperties();
+        // now unwrap properties, which might reference other registered objects
+        for (const auto &kv : _objects) {
+            kv.second->unwrapProperties();
+        }
     }
+    _initialized = true;
     if (initCallback) {
         initCallback(this);
     }
 
+    std::vector<InitCallbackHandler> waiters;
+    waiters.swap(initWaiters);
+    for (const auto &waiter : waiters) {
+        waiter(this);
+    }
+
     if (_autoIdle) {
         idle();
     }
 }
 
 
+template<class Json>
+inline void BasicQWebChannel<Json>::build_objects_parallel(const json_t &data)
+{
+    std::vector<std::pair<const string_t*, const json_t*>> entries;
+    entries.reserve(data.size());
+    for (auto prop = data.begin(); prop != data.end(); ++prop) {
+        entries.emplace_back(&prop.key(), &prop.value());
+    }
+
+    // small partitions are not worth starting a thread
+    const std::size_t minObjectsPerThread = 64;
+    const std::size_t threads = std::max<std::size_t>(
+        1, std::min(_initThreads, entries.size() / minObjectsPerThread));
+
+    std::vector<BasicQObject<json_t>*> built(entries.size(), nullptr);
+    std::vector<std::exception_ptr> errors(threads);
+
+    auto build = [this, &entries, &built, &errors, threads](std::size_t part) {
+        const std::size_t begin = entries.size() * part / threads;
+        const std::size_t end = entries.size() * (part + 1) / threads;
+        try {
+            for (std::size_t i = begin; i < end; ++i) {
+                built[i] = new BasicQObject<json_t>(*entries[i].first, this);
+                built[i]->load(*entries[i].second);
+            }
+        } catch (...) {
+            errors[part] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (std::size_t part = 1; part < threads; ++part) {
+        workers.emplace_back(build, part);
+    }
+    build(0);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    for (const auto &error : errors) {
+        if (error) {
+            for (auto *object : built) {
+                delete object;
+            }
+            std::rethrow_exception(error);
+        }
+    }
+
+    // in the order of the Init response, like a single-threaded init
+    for (auto *object : built) {
+        object->attach();
+    }
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::when_initialized(InitCallbackHandler callback)
+{
+    if (_initialized) {
+        callback(this);
+        return;
+    }
+    initWaiters.push_back(std::move(callback));
+}
+
+
 template<class Json>
 inline BasicQObject<Json> *BasicQWebChannel<Json>::object(const string_t &name) const
 {
-    auto it = _objects.find(name);
-    if (it == _objects.end()) {
+    // building a lazy object does not change what the channel represents
+    return const_cast<BasicQWebChannel*>(this)->find_object(name.data(), name.size());
+}
+
+
+template<class Json>
+inline const std::map<typename Json::string_t, BasicQObject<Json>*> &BasicQWebChannel<Json>::objects() const
+{
+    const_cast<BasicQWebChannel*>(this)->materialize_all();
+    return _objects;
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::register_object(BasicQObject<json_t> *object)
+{
+    const string_t &name = object->id();
+    _objects[name] = object;
+
+    ObjectSlot slot;
+    slot.object = object;
+    registry.set_value(registry.intern(name), slot);
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::unregister_object(const string_t &name)
+{
+    _objects.erase(name);
+
+    // frees the interned name, so objects created and destroyed at run time don't accumulate
+    const auto handle = registry.find(name);
+    if (handle != decltype(registry)::npos) {
+        registry.remove(handle);
+    }
+}
+
+
+template<class Json>
+inline bool BasicQWebChannel<Json>::knows_object(const char *name, std::size_t size) const
+{
+    const auto handle = registry.find(name, size);
+    if (handle == decltype(registry)::npos) {
+        return false;
+    }
+
+    const ObjectSlot &slot = registry.value(handle);
+    return slot.object || slot.metadata;
+}
+
+
+template<class Json>
+inline BasicQObject<Json> *BasicQWebChannel<Json>::find_object(const char *name, std::size_t size)
+{
+    const auto handle = registry.find(name, size);
+    if (handle == decltype(registry)::npos) {
         return nullptr;
     }
-    return it->second;
+
+    const ObjectSlot &slot = registry.value(handle);
+    if (slot.object || !slot.metadata) {
+        return slot.object;
+    }
+    return materialize(handle);
+}
+
+
+template<class Json>
+inline BasicQObject<Json> *BasicQWebChannel<Json>::materialize(typename ObjectRegistry<ObjectSlot, string_t>::Handle handle)
+{
+    const string_t name = registry.name(handle);
+    const json_t *metadata = registry.value(handle).metadata;
+    registry.set_value(handle, ObjectSlot());
+
+    BasicQObject<json_t> *object = new BasicQObject<json_t>(name, *metadata, this);
+    lazyMetadata.erase(name);
+
+    // properties may refer to other objects, which are built in turn. This one is registered
+    // already, so references back to it resolve.
+    object->unwrapProperties();
+    return object;
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::materialize_all()
+{
+    while (!lazyMetadata.empty()) {
+        const string_t name = lazyMetadata.begin().key();
+        const auto handle = registry.find(name);
+        if (handle == decltype(registry)::npos || !registry.value(handle).metadata) {
+            // replaced by an object that was created otherwise
+            lazyMetadata.erase(name);
+            continue;
+        }
+        materialize(handle);
+    }
 }
 
 
 template<class Json>
 inline void BasicQWebChannel<Json>::send(const json_t &o)
 {
-    transport.send(o);
+    if (!transport.accepts_serialized()) {
+        transport.send(o);
+        return;
+    }
+
+    // serialize into a buffer recycled by the transport, which is queued as is
+    std::string buffer = transport.acquire_buffer();
+    writer.write_value(buffer, o);
+    transport.send_serialized(std::move(buffer));
 }
 
 
 template<class Json>
 inline void BasicQWebChannel<Json>::message_handler(const json_t &data)
 {
+    process_timeouts();
+    process_submissions();
+
     switch (data["type"].template get<int>())
     {
     case BasicQWebChannelMessageTypes::QSignal:
@@ -104,6 +327,56 @@ inline void BasicQWebChannel<Json>::message_handler(const json_t &data)
 }
 
 
+template<class Json>
+inline void BasicQWebChannel<Json>::serialized_message_handler(const char *data, std::size_t size)
+{
+    process_timeouts();
+    process_submissions();
+
+    if (!decoder.decode(data, size)) {
+        std::cerr << "invalid message received: " << std::string(data, size) << std::endl;
+        return;
+    }
+
+    auto &message = decoder.message();
+    if (!message.complete) {
+        // e.g. a response whose data is an array, which was decoded as property updates
+        this->message_handler(json_t::parse(data, data + size));
+        return;
+    }
+
+    // handlers may cause the next message to be decoded, so take the payload out first
+    switch (message.type)
+    {
+    case BasicQWebChannelMessageTypes::QSignal: {
+        // the object name is looked up before any handler runs, so it can stay in the decoder
+        const json_t args = message.hasArgs ? std::move(message.args) : json_t::array();
+        this->handle_signal(message.object, message.signal, args);
+        break;
+    }
+    case BasicQWebChannelMessageTypes::Response: {
+        this->handle_response(message.id, std::move(message.data));
+        break;
+    }
+    case BasicQWebChannelMessageTypes::PropertyUpdate: {
+        const auto updates = std::move(message.updates);
+        for (const auto &update : updates) {
+            if (update.skipped) {
+                std::cerr << "Unhandled property updates: " << update.object << std::endl;
+                continue;
+            }
+            this->handle_property_update(update.object, update.signals, update.properties);
+        }
+
+        if (_autoIdle) {
+            idle();
+        }
+        break;
+    }
+    }
+}
+
+
 template<class Json>
 inline void BasicQWebChannel<Json>::exec(json_t data, CallbackHandler callback)
 {
@@ -118,20 +391,161 @@ inline void BasicQWebChannel<Json>::exec(json_t data, CallbackHandler callback)
         return;
     }
 
-    data["id"] = this->execId++;
-    this->execCallbacks[data["id"].template get<int>()] = callback;
+    // plain callbacks only learn about answers
+    data["id"] = add_callback([callback](ExecStatus status, const json_t &response) {
+        if (status == ExecStatus::Ok) {
+            callback(response);
+        }
+    }, _defaultTimeout);
     this->send(data);
 }
 
 
+template<class Json>
+inline unsigned int BasicQWebChannel<Json>::add_callback(StatusCallbackHandler callback, std::chrono::milliseconds timeout)
+{
+    const unsigned int id = this->execCallbacks.insert(std::move(callback));
+    if (timeout.count() > 0) {
+        // not removed when the answer arrives; process_timeouts() skips completed requests
+        timeouts.schedule(id, TimerWheel<unsigned int>::clock::now() + timeout);
+    }
+    return id;
+}
+
+
+template<class Json>
+inline std::size_t BasicQWebChannel<Json>::process_timeouts()
+{
+    if (timeouts.empty()) {
+        return 0;
+    }
+
+    std::size_t count = 0;
+    timeouts.advance(TimerWheel<unsigned int>::clock::now(), [this, &count](unsigned int id) {
+        StatusCallbackHandler callback;
+        if (!this->execCallbacks.take(id, callback)) {
+            // answered in time
+            return;
+        }
+
+        ++count;
+        if (callback) {
+            callback(ExecStatus::Timeout, json_t());
+        }
+    });
+    return count;
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::submit(std::function<void()> task)
+{
+    submissions.push(std::move(task));
+
+    // only the first submission after the channel started draining wakes it up
+    if (!submissionsPending.exchange(true) && submissionNotifier) {
+        submissionNotifier();
+    }
+}
+
+
+template<class Json>
+inline std::size_t BasicQWebChannel<Json>::process_submissions()
+{
+    if (!submissionsPending.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    // cleared before draining, so a task submitted meanwhile notifies again. An exchange, so that
+    // tasks of submitters that found the flag still set are visible below.
+    submissionsPending.exchange(false);
+
+    std::size_t count = 0;
+    std::function<void()> task;
+    while (submissions.pop(task)) {
+        ++count;
+        task();
+    }
+    return count;
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::invoke_method(const string_t &object, int method, const std::vector<json_t> &args,
+                                                  StatusCallbackHandler callback, std::chrono::milliseconds timeout)
+{
+    const unsigned int id = add_callback(std::move(callback), timeout);
+
+    if (!transport.accepts_serialized()) {
+        this->send(json_t {
+            { "type", BasicQWebChannelMessageTypes::InvokeMethod },
+            { "method", method },
+            { "args", args },
+            { "object", object },
+            { "id", id },
+        });
+        return;
+    }
+
+    std::string buffer = transport.acquire_buffer();
+    writer.write_invoke(buffer, object, method, args, id);
+    transport.send_serialized(std::move(buffer));
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::set_object_property(const string_t &object, int property, const json_t &value)
+{
+    if (!transport.accepts_serialized()) {
+        this->exec(json_t {
+            { "type", BasicQWebChannelMessageTypes::SetProperty },
+            { "property", property },
+            { "value", value },
+            { "object", object },
+        });
+        return;
+    }
+
+    std::string buffer = transport.acquire_buffer();
+    writer.write_set_property(buffer, object, property, value);
+    transport.send_serialized(std::move(buffer));
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::signal_connection(int type, const string_t &object, int signal)
+{
+    if (!transport.accepts_serialized()) {
+        this->exec(json_t {
+            { "type", type },
+            { "object", object },
+            { "signal", signal },
+        });
+        return;
+    }
+
+    std::string buffer = transport.acquire_buffer();
+    writer.write_signal_connection(buffer, type, object, signal);
+    transport.send_serialized(std::move(buffer));
+}
+
+
 template<class Json>
 inline void BasicQWebChannel<Json>::handle_signal(const json_t &message)
 {
-    auto it = this->_objects.find(message["object"].template get<string_t>());
-    if (it != this->_objects.end()) {
-        it->second->signalEmitted(message["signal"].template get<int>(), message.value("args", typename Json::array_t{}));
+    this->handle_signal(message["object"].template get_ref<const string_t &>(), message["signal"].template get<int>(),
+                        message.value("args", typename Json::array_t{}));
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::handle_signal(const string_t &object, int signal, const json_t &args)
+{
+    BasicQObject<json_t> *target = find_object(object.data(), object.size());
+    if (target) {
+        target->signalEmitted(signal, args);
     } else {
-        std::cerr << "Unhandled signal: " << message["object"] << "::" << message["signal"] << std::endl;
+        std::cerr << "Unhandled signal: " << object << "::" << signal << std::endl;
     }
 }
 
@@ -144,8 +558,38 @@ inline void BasicQWebChannel<Json>::handle_response(const json_t &message)
         return;
     }
 
-    this->execCallbacks[message["id"].template get<int>()](message["data"]);
-    this->execCallbacks.erase(message["id"].template get<int>());
+    this->handle_response(message["id"].template get<unsigned int>(), message["data"]);
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::handle_response(unsigned int id, const json_t &data)
+{
+    StatusCallbackHandler callback;
+    if (!this->execCallbacks.take(id, callback)) {
+        std::cerr << "Response to unknown or timed out request " << id << " received" << std::endl;
+        return;
+    }
+
+    if (callback) {
+        callback(ExecStatus::Ok, data);
+    }
+}
+
+
+template<class Json>
+inline void BasicQWebChannel<Json>::handle_response(unsigned int id, json_t &&data)
+{
+    // lazy objects keep the Init data until they are used, which saves copying it
+    if (id == _initRequestId && _lazyObjects && !_initialized) {
+        lazyMetadata = std::move(data);
+        this->handle_response(id, lazyMetadata);
+        return;
+    }
+
+    // handlers may cause the next message to be decoded into @p data, so take it out first
+    const json_t result = std::move(data);
+    this->handle_response(id, result);
 }
 
 
@@ -153,12 +597,7 @@ template<class Json>
 inline void BasicQWebChannel<Json>::handle_property_update(const json_t &message)
 {
     for (const json_t &data : message["data"]) {
-        auto it = this->_objects.find(data["object"].template get<string_t>());
-        if (it != this->_objects.end()) {
-            it->second->propertyUpdate(data["signals"], data["properties"]);
-        } else {
-            std::cerr << "Unhandled property updates: " << data["object"] << "::" << data["properties"] << std::endl;
-        }
+        this->handle_property_update(data["object"].template get_ref<const string_t &>(), data["signals"], data["properties"]);
     }
 
     if (_autoIdle) {
@@ -166,6 +605,18 @@ inline void BasicQWebChannel<Json>::handle_property_update(const json_t &message
     }
 }
 
+
+template<class Json>
+inline void BasicQWebChannel<Json>::handle_property_update(const string_t &object, const json_t &signals, const json_t &properties)
+{
+    BasicQObject<json_t> *target = find_object(object.data(), object.size());
+    if (target) {
+        target->propertyUpdate(signals, properties);
+    } else {
+        std::cerr << "Unhandled property updates: " << object << "::" << properties << std::endl;
+    }
+}
+
 }
 
 #endif // QWEBCHANNEL_IMPL_H
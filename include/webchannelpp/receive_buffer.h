@@ -0,0 +1,137 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef RECEIVE_BUFFER_H
+#define RECEIVE_BUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "byte_search.h"
+
+namespace WebChannelPP
+{
+
+/// @brief Non-owning view of a single frame inside a ReceiveBuffer.
+///
+/// The view is only valid until the next call to `prepare()` or `append()` on the buffer it came from.
+struct FrameView
+{
+    const char *data;
+    std::size_t size;
+
+    const char *begin() const { return data; }
+    const char *end() const { return data + size; }
+};
+
+/// @brief Growable byte buffer with independent read and write cursors.
+///
+/// Consuming a frame only advances the read cursor. Unconsumed bytes are moved back to the
+/// front lazily, when `prepare()` runs out of room at the end, so each byte is moved at most
+/// once per refill instead of once per extracted frame.
+class ReceiveBuffer
+{
+    std::vector<char> m_storage;
+    std::size_t m_begin = 0;
+    std::size_t m_end = 0;
+    // bytes before this offset are known not to contain a delimiter
+    std::size_t m_scanned = 0;
+
+public:
+    explicit ReceiveBuffer(std::size_t capacity = 4096)
+        : m_storage(capacity)
+    {
+    }
+
+    /// @brief Returns a pointer to the first unconsumed byte
+    const char *data() const { return m_storage.data() + m_begin; }
+    char *data() { return m_storage.data() + m_begin; }
+    /// @brief Returns the number of unconsumed bytes
+    std::size_t size() const { return m_end - m_begin; }
+    bool empty() const { return m_begin == m_end; }
+
+    /// @brief Returns the total size of the underlying storage
+    std::size_t capacity() const { return m_storage.size(); }
+    /// @brief Returns the number of bytes that can be written without compacting or growing
+    std::size_t writable() const { return m_storage.size() - m_end; }
+
+    /// @brief Returns a pointer to at least @p n writable bytes at the end of the buffer.
+    ///        Invalidates all previously returned pointers and frame views.
+    char *prepare(std::size_t n)
+    {
+        if (writable() < n && m_begin > 0) {
+            compact();
+        }
+
+        if (writable() < n) {
+            m_storage.resize(std::max(m_storage.size() * 2, m_end + n));
+        }
+
+        return m_storage.data() + m_end;
+    }
+
+    /// @brief Marks @p n bytes written into the region returned by `prepare()` as readable
+    void commit(std::size_t n)
+    {
+        m_end += n;
+    }
+
+    /// @brief Copies @p n bytes from @p data to the end of the buffer
+    void append(const char *data, std::size_t n)
+    {
+        std::memcpy(prepare(n), data, n);
+        commit(n);
+    }
+
+    /// @brief Discards @p n bytes from the front of the buffer
+    void consume(std::size_t n)
+    {
+        m_begin += n;
+        if (m_begin == m_end) {
+            // cheap reset, keeps the next write at the start of the storage
+            m_begin = m_end = m_scanned = 0;
+        } else if (m_scanned < m_begin) {
+            m_scanned = m_begin;
+        }
+    }
+
+    /// @brief Extracts the next @p delimiter terminated frame, without the delimiter.
+    ///
+    /// Scanning resumes where the previous unsuccessful call stopped, so bytes of an incomplete
+    /// frame are only searched once no matter how many reads it takes to complete it.
+    /// @return false if no complete frame is buffered
+    bool next_line(FrameView &frame, char delimiter = '\n')
+    {
+        const char *first = data();
+        const char *last = m_storage.data() + m_end;
+        const char *pos = find_byte(m_storage.data() + m_scanned, last, delimiter);
+        if (pos == last) {
+            m_scanned = m_end;
+            return false;
+        }
+
+        const std::size_t length = pos - first;
+        frame = FrameView { first, length };
+        consume(length + 1);
+        return true;
+    }
+
+private:
+    void compact()
+    {
+        const std::size_t remaining = size();
+        std::memmove(m_storage.data(), m_storage.data() + m_begin, remaining);
+        m_scanned -= m_begin;
+        m_begin = 0;
+        m_end = remaining;
+    }
+};
+
+}
+
+#endif // RECEIVE_BUFFER_H
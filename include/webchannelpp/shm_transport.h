@@ -0,0 +1,520 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+#ifndef __linux__
+#error "shm_transport.h requires Linux (POSIX shared memory and futexes)"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "qwebchannel_fwd.h"
+#include "wire_format.h"
+
+namespace WebChannelPP
+{
+
+namespace detail
+{
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+              "futex words must be plain 32 bit integers");
+
+inline void futex_wait(std::atomic<std::uint32_t> &word, std::uint32_t expected, std::chrono::microseconds timeout)
+{
+    struct timespec ts;
+    ts.tv_sec = timeout.count() / 1000000;
+    ts.tv_nsec = (timeout.count() % 1000000) * 1000;
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<std::uint32_t> &word)
+{
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+/// @brief Control block of a single-producer single-consumer byte ring in shared memory
+struct ShmRingHeader
+{
+    // total number of bytes ever written and read, the ring offsets are these modulo the capacity
+    alignas(64) std::atomic<std::uint64_t> head;
+    alignas(64) std::atomic<std::uint64_t> tail;
+
+    // futex words, bumped whenever data or space becomes available
+    alignas(64) std::atomic<std::uint32_t> dataSeq;
+    std::atomic<std::uint32_t> consumerWaiting;
+    alignas(64) std::atomic<std::uint32_t> spaceSeq;
+    std::atomic<std::uint32_t> producerWaiting;
+};
+
+/// @brief Lock-free SPSC ring of length-prefixed records, operating on memory it does not own.
+///
+/// The other end of the ring is another process, so records are checked before they are
+/// copied out. A ring that holds an invalid record is marked corrupt and reads as empty.
+class ShmRing
+{
+    ShmRingHeader *m_header = nullptr;
+    char *m_data = nullptr;
+    std::uint64_t m_capacity = 0;
+    std::uint32_t m_maxRecord = 0;
+    bool m_corrupt = false;
+
+public:
+    ShmRing() = default;
+    ShmRing(ShmRingHeader *header, char *data, std::uint64_t capacity)
+        : m_header(header), m_data(data), m_capacity(capacity),
+          m_maxRecord(std::uint32_t(std::min<std::uint64_t>(capacity - sizeof(std::uint32_t), std::numeric_limits<std::uint32_t>::max())))
+    {
+    }
+
+    std::uint64_t capacity() const { return m_capacity; }
+
+    /// @brief Returns the size of the largest record `try_read()` accepts
+    std::uint32_t max_record() const { return m_maxRecord; }
+    /// @brief Makes `try_read()` treat records larger than @p size as corruption. Records can
+    ///        never be larger than the ring.
+    void set_max_record(std::uint32_t size)
+    {
+        m_maxRecord = std::uint32_t(std::min<std::uint64_t>(size, m_capacity - sizeof(std::uint32_t)));
+    }
+
+    /// @brief Returns whether an invalid record was found
+    bool corrupt() const { return m_corrupt; }
+
+    /// @brief Appends a record of @p size bytes
+    /// @return false if the ring has not enough free space
+    bool try_write(const char *data, std::uint32_t size)
+    {
+        if (free_space() < sizeof(size) + size) {
+            return false;
+        }
+
+        const std::uint64_t head = m_header->head.load(std::memory_order_relaxed);
+        copy_in(head, reinterpret_cast<const char*>(&size), sizeof(size));
+        copy_in(head + sizeof(size), data, size);
+        m_header->head.store(head + sizeof(size) + size, std::memory_order_seq_cst);
+
+        m_header->dataSeq.fetch_add(1, std::memory_order_seq_cst);
+        if (m_header->consumerWaiting.load(std::memory_order_seq_cst)) {
+            futex_wake(m_header->dataSeq);
+        }
+        return true;
+    }
+
+    /// @brief Removes the oldest record and stores it in @p scratch
+    /// @return false if the ring is empty or corrupt
+    bool try_read(std::string &scratch)
+    {
+        const std::uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+        const std::uint64_t head = m_header->head.load(std::memory_order_acquire);
+        if (head == tail || m_corrupt) {
+            return false;
+        }
+
+        // the producer never publishes partial records, so anything else is garbage
+        const std::uint64_t available = head - tail;
+        std::uint32_t size = 0;
+        if (available >= sizeof(size) && available <= m_capacity) {
+            copy_out(tail, reinterpret_cast<char*>(&size), sizeof(size));
+        }
+        if (available < sizeof(size) || available > m_capacity ||
+            size > available - sizeof(size) || size > m_maxRecord) {
+            std::cerr << "Invalid record in shared memory ring: " << size << " of " << available << " bytes" << std::endl;
+            m_corrupt = true;
+            return false;
+        }
+
+        scratch.resize(size);
+        copy_out(tail + sizeof(size), &scratch[0], size);
+        m_header->tail.store(tail + sizeof(size) + size, std::memory_order_seq_cst);
+
+        m_header->spaceSeq.fetch_add(1, std::memory_order_seq_cst);
+        if (m_header->producerWaiting.load(std::memory_order_seq_cst)) {
+            futex_wake(m_header->spaceSeq);
+        }
+        return true;
+    }
+
+    bool empty() const
+    {
+        return m_corrupt ||
+               m_header->head.load(std::memory_order_acquire) == m_header->tail.load(std::memory_order_acquire);
+    }
+
+    /// @brief Sleeps until a record is available or @p timeout expires
+    void wait_for_data(std::chrono::microseconds timeout)
+    {
+        wait(m_header->dataSeq, m_header->consumerWaiting, timeout, [this] { return !empty(); });
+    }
+
+    /// @brief Sleeps until a record of @p size bytes fits or @p timeout expires
+    void wait_for_space(std::uint32_t size, std::chrono::microseconds timeout)
+    {
+        wait(m_header->spaceSeq, m_header->producerWaiting, timeout, [this, size] {
+            return free_space() >= sizeof(size) + size;
+        });
+    }
+
+private:
+    std::uint64_t free_space() const
+    {
+        const std::uint64_t head = m_header->head.load(std::memory_order_relaxed);
+        return m_capacity - (head - m_header->tail.load(std::memory_order_acquire));
+    }
+
+    template<class Ready>
+    static void wait(std::atomic<std::uint32_t> &seq, std::atomic<std::uint32_t> &waiting,
+                     std::chrono::microseconds timeout, Ready ready)
+    {
+        waiting.store(1, std::memory_order_seq_cst);
+        const std::uint32_t current = seq.load(std::memory_order_seq_cst);
+        if (!ready()) {
+            futex_wait(seq, current, timeout);
+        }
+        waiting.store(0, std::memory_order_relaxed);
+    }
+
+    void copy_in(std::uint64_t pos, const char *data, std::size_t size)
+    {
+        const std::size_t offset = pos % m_capacity;
+        const std::size_t first = std::min<std::size_t>(size, m_capacity - offset);
+        std::memcpy(m_data + offset, data, first);
+        std::memcpy(m_data, data + first, size - first);
+    }
+
+    void copy_out(std::uint64_t pos, char *data, std::size_t size) const
+    {
+        const std::size_t offset = pos % m_capacity;
+        const std::size_t first = std::min<std::size_t>(size, m_capacity - offset);
+        std::memcpy(data, m_data + offset, first);
+        std::memcpy(data + first, m_data, size - first);
+    }
+};
+
+}
+
+/// @brief Which end of a shared memory channel a ShmTransport represents
+enum class ShmRole
+{
+    /// Creates the shared memory segment; stands in for the QWebChannel host
+    Host,
+    /// Attaches to a segment created by a host
+    Client,
+};
+
+/// @brief Transport over a pair of lock-free rings in POSIX shared memory.
+///
+/// Meant for processes on the same host that need round trips well below what sockets
+/// allow. One side is created with ShmRole::Host, which creates the segment, the other
+/// with ShmRole::Client. There is no event loop integration: the owner calls `poll()`
+/// or `run_once()` to dispatch incoming messages, typically from a dedicated thread.
+///
+/// Constructing a transport throws std::system_error if the segment cannot be set up.
+/// Incoming records are validated; if the peer wrote an invalid one, `corrupt()` returns true
+/// and no further messages are received.
+class ShmTransport : public Transport
+{
+    static constexpr std::uint64_t magic = 0x5745424348534d31; // "WEBCHSM1"
+
+    struct SegmentHeader
+    {
+        std::uint64_t magic;
+        std::uint64_t capacity;
+        // ring 0 carries host -> client messages, ring 1 client -> host
+        detail::ShmRingHeader rings[2];
+    };
+
+    std::string m_name;
+    ShmRole m_role;
+    void *m_mapping = MAP_FAILED;
+    std::size_t m_mappingSize = 0;
+
+    detail::ShmRing m_inbound;
+    detail::ShmRing m_outbound;
+
+    message_handler m_handler;
+    serialized_message_handler m_serializedHandler;
+    BasicMessageEncoder<nlohmann::json> m_encoder;
+    std::string m_sendScratch;
+    // the message being dispatched; handlers see its data, so nothing else writes to it
+    std::string m_receiveScratch;
+    std::deque<std::string> m_backlog;
+    bool m_busyPoll = false;
+    std::atomic<bool> m_stopped { false };
+
+public:
+    /// @brief Creates (ShmRole::Host) or attaches to (ShmRole::Client) the segment @p name.
+    ///        @p capacity is the size of each direction's ring and only used by the host.
+    ///
+    /// The host always creates a new segment. A segment left behind under @p name, e.g. by a
+    /// host that crashed, is unlinked first; clients still attached to it keep their mapping.
+    ShmTransport(const std::string &name, ShmRole role, std::uint64_t capacity = 1024 * 1024)
+        : m_name(name), m_role(role)
+    {
+        int fd;
+        if (role == ShmRole::Host) {
+            fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd < 0 && errno == EEXIST && shm_unlink(name.c_str()) == 0) {
+                fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            }
+        } else {
+            fd = shm_open(name.c_str(), O_RDWR, 0600);
+        }
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+        }
+
+        if (role == ShmRole::Host) {
+            m_mappingSize = sizeof(SegmentHeader) + 2 * capacity;
+            if (ftruncate(fd, m_mappingSize) < 0) {
+                const int err = errno;
+                close(fd);
+                shm_unlink(name.c_str());
+                throw std::system_error(err, std::generic_category(), "ftruncate " + name);
+            }
+        } else {
+            struct stat st;
+            if (fstat(fd, &st) < 0 || std::size_t(st.st_size) < sizeof(SegmentHeader)) {
+                close(fd);
+                throw std::system_error(EINVAL, std::generic_category(), "invalid shared memory segment " + name);
+            }
+            m_mappingSize = st.st_size;
+        }
+
+        m_mapping = mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        const int err = errno;
+        close(fd);
+        if (m_mapping == MAP_FAILED) {
+            if (role == ShmRole::Host) {
+                shm_unlink(name.c_str());
+            }
+            throw std::system_error(err, std::generic_category(), "mmap " + name);
+        }
+
+        SegmentHeader *segment = static_cast<SegmentHeader*>(m_mapping);
+        if (role == ShmRole::Host) {
+            // fresh pages from ftruncate are zeroed, which is a valid empty ring
+            segment->capacity = capacity;
+            std::atomic_thread_fence(std::memory_order_release);
+            segment->magic = magic;
+        } else if (segment->magic != magic || segment->capacity <= sizeof(std::uint32_t) ||
+                   segment->capacity > (m_mappingSize - sizeof(SegmentHeader)) / 2) {
+            munmap(m_mapping, m_mappingSize);
+            throw std::system_error(EINVAL, std::generic_category(), "invalid shared memory segment " + name);
+        }
+
+        char *data = static_cast<char*>(m_mapping) + sizeof(SegmentHeader);
+        const std::uint64_t ringCapacity = segment->capacity;
+        detail::ShmRing hostToClient(&segment->rings[0], data, ringCapacity);
+        detail::ShmRing clientToHost(&segment->rings[1], data + ringCapacity, ringCapacity);
+
+        m_outbound = role == ShmRole::Host ? hostToClient : clientToHost;
+        m_inbound = role == ShmRole::Host ? clientToHost : hostToClient;
+    }
+
+    ShmTransport(const ShmTransport &) = delete;
+    ShmTransport &operator=(const ShmTransport &) = delete;
+
+    ~ShmTransport()
+    {
+        if (m_mapping != MAP_FAILED) {
+            munmap(m_mapping, m_mappingSize);
+        }
+        if (m_role == ShmRole::Host) {
+            shm_unlink(m_name.c_str());
+        }
+    }
+
+    ShmRole role() const { return m_role; }
+
+    WireFormat wire_format() const { return m_encoder.format(); }
+    /// @brief Selects the encoding of messages. Records are length-prefixed, so all formats work.
+    void set_wire_format(WireFormat format) { m_encoder.set_format(format); }
+
+    /// @brief Returns the size of the largest message that is accepted
+    std::uint32_t max_message_size() const { return m_inbound.max_record(); }
+    /// @brief Treats incoming messages larger than @p size as corruption, which bounds the memory
+    ///        a misbehaving peer can make this side allocate. Defaults to the ring capacity.
+    void set_max_message_size(std::uint32_t size) { m_inbound.set_max_record(size); }
+
+    /// @brief Returns whether the peer wrote an invalid record. Nothing is received afterwards.
+    bool corrupt() const { return m_inbound.corrupt(); }
+
+    /// @brief Returns whether waiting spins instead of sleeping
+    bool busy_poll() const { return m_busyPoll; }
+    /// @brief Spin instead of sleeping on a futex while waiting. Lowest latency at the cost of a
+    ///        busy core; only useful if both ends have a core of their own.
+    void set_busy_poll(bool enabled) { m_busyPoll = enabled; }
+
+    /// @brief Sends @p s. Blocks while the outbound ring is full.
+    ///
+    /// While blocked, incoming messages are moved out of the inbound ring, so two peers
+    /// sending to each other cannot deadlock. They are dispatched by the next `poll()`.
+    void send(const nlohmann::json &s) override
+    {
+        m_sendScratch.clear();
+        m_encoder.encode(s, m_sendScratch);
+        write_record(m_sendScratch);
+    }
+
+    bool accepts_serialized() const override { return !is_binary(m_encoder.format()); }
+
+    /// @brief Sends @p message like `send()`. The bytes are copied into the ring directly.
+    void send_serialized(std::string &&message) override
+    {
+        if (is_binary(m_encoder.format())) {
+            send(nlohmann::json::parse(message));
+        } else {
+            write_record(message);
+        }
+
+        // keep the larger buffer for the next acquire_buffer()
+        if (message.capacity() > m_sendScratch.capacity()) {
+            m_sendScratch = std::move(message);
+        }
+    }
+
+    /// @brief Hands out the send buffer of the transport; it is taken back by `send_serialized()`
+    std::string acquire_buffer() override
+    {
+        std::string buffer = std::move(m_sendScratch);
+        buffer.clear();
+        return buffer;
+    }
+
+    void register_message_handler(message_handler handler) override
+    {
+        m_handler = std::move(handler);
+    }
+
+    /// @brief Messages in the JSON wire format are passed to @p handler without being parsed
+    bool register_serialized_message_handler(serialized_message_handler handler) override
+    {
+        m_serializedHandler = std::move(handler);
+        return true;
+    }
+
+    /// @brief Dispatches all messages that are currently available, without blocking
+    /// @return The number of dispatched messages
+    std::size_t poll()
+    {
+        std::size_t count = 0;
+        for (;;) {
+            // handlers may send and thereby move more messages to the backlog, which always
+            // holds older messages than the ring
+            if (!m_backlog.empty()) {
+                m_receiveScratch = std::move(m_backlog.front());
+                m_backlog.pop_front();
+            } else if (!m_inbound.try_read(m_receiveScratch)) {
+                break;
+            }
+
+            ++count;
+            deliver();
+        }
+        return count;
+    }
+
+    /// @brief Waits up to @p timeout for messages and dispatches them
+    /// @return The number of dispatched messages
+    std::size_t run_once(std::chrono::microseconds timeout = std::chrono::milliseconds(100))
+    {
+        if (m_inbound.empty() && m_backlog.empty()) {
+            if (m_busyPoll) {
+                const auto deadline = std::chrono::steady_clock::now() + timeout;
+                while (m_inbound.empty() && std::chrono::steady_clock::now() < deadline) {
+                }
+            } else {
+                m_inbound.wait_for_data(timeout);
+            }
+        }
+        return poll();
+    }
+
+    /// @brief Dispatches messages until `stop()` is called
+    void run()
+    {
+        // a stop() issued before run() makes it return right away; either way it is used up
+        while (!m_stopped.exchange(false)) {
+            run_once();
+        }
+    }
+
+    /// @brief Makes the current or next `run()` return after at most one wait interval.
+    ///        Safe to call from any thread.
+    void stop()
+    {
+        m_stopped = true;
+    }
+
+private:
+    void write_record(const std::string &record)
+    {
+        if (sizeof(std::uint32_t) + record.size() > m_outbound.capacity()) {
+            std::cerr << "Message of " << record.size() << " bytes exceeds the shared memory ring" << std::endl;
+            return;
+        }
+
+        while (!m_outbound.try_write(record.data(), std::uint32_t(record.size()))) {
+            // may run from a handler, which still refers to m_receiveScratch
+            std::string drained;
+            while (m_inbound.try_read(drained)) {
+                m_backlog.push_back(std::move(drained));
+                drained = std::string();
+            }
+
+            if (!m_busyPoll) {
+                m_outbound.wait_for_space(std::uint32_t(record.size()), std::chrono::milliseconds(10));
+            }
+        }
+    }
+
+    void deliver()
+    {
+        if (m_serializedHandler && !is_binary(m_encoder.format())) {
+            m_serializedHandler(m_receiveScratch.data(), m_receiveScratch.size());
+            return;
+        }
+
+        if (!m_handler) {
+            return;
+        }
+
+        nlohmann::json msg;
+        try {
+            msg = decode_message<nlohmann::json>(m_receiveScratch.data(), m_receiveScratch.size(), m_encoder.format());
+        } catch (const nlohmann::json::exception &e) {
+            std::cerr << "Invalid message received: " << e.what() << std::endl;
+            return;
+        }
+
+        m_handler(msg);
+    }
+};
+
+}
+
+#endif // SHM_TRANSPORT_H
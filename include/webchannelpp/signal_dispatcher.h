@@ -0,0 +1,179 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef SIGNAL_DISPATCHER_H
+#define SIGNAL_DISPATCHER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace WebChannelPP
+{
+
+/// @brief How signal callbacks run by a SignalDispatcher are ordered
+enum class SignalOrder {
+    /// Callbacks of one object run one after another, in the order the signals arrived
+    PerObject,
+    /// Callbacks of one signal of an object run one after another; different signals run in parallel
+    PerSignal,
+};
+
+/// @brief Thread pool that runs signal callbacks off the thread of the channel, see
+///        `BasicQWebChannel::set_signal_dispatcher()`.
+///
+/// Tasks are posted with a key. Tasks with the same key run one after another in the order they
+/// were posted, tasks with different keys run in parallel. The number of tasks that were posted
+/// but did not finish yet is bounded: `post()` blocks while it is reached, which stops the channel
+/// from reading further messages until the callbacks caught up.
+class SignalDispatcher
+{
+    struct Strand
+    {
+        std::deque<std::function<void()>> tasks;
+        // queued in m_ready or running on a worker
+        bool active = false;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_spaceAvailable;
+    std::condition_variable m_idle;
+
+    std::unordered_map<std::size_t, Strand> m_strands;
+    std::deque<std::size_t> m_ready;
+    std::size_t m_pending = 0;
+    std::size_t m_capacity;
+    bool m_stopping = false;
+
+    std::vector<std::thread> m_threads;
+
+public:
+    /// @param threads Number of worker threads; 0 selects the number of cores
+    /// @param capacity Number of unfinished tasks at which `post()` blocks
+    explicit SignalDispatcher(std::size_t threads = 0, std::size_t capacity = 1024)
+        : m_capacity(capacity > 0 ? capacity : 1)
+    {
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        if (threads == 0) {
+            threads = 1;
+        }
+
+        m_threads.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i) {
+            m_threads.emplace_back([this]() { work(); });
+        }
+    }
+
+    SignalDispatcher(const SignalDispatcher &) = delete;
+    SignalDispatcher &operator=(const SignalDispatcher &) = delete;
+
+    /// @brief Runs the remaining tasks and stops the workers
+    ~SignalDispatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_workAvailable.notify_all();
+
+        for (auto &thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    /// @brief Queues @p task behind the other tasks with @p key. Blocks while `capacity` tasks are unfinished.
+    ///        Must not be called from a task, which could wait for itself.
+    void post(std::size_t key, std::function<void()> task)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_spaceAvailable.wait(lock, [this]() { return m_pending < m_capacity; });
+
+        Strand &strand = m_strands[key];
+        strand.tasks.push_back(std::move(task));
+        ++m_pending;
+
+        if (!strand.active) {
+            strand.active = true;
+            m_ready.push_back(key);
+            lock.unlock();
+            m_workAvailable.notify_one();
+        }
+    }
+
+    /// @brief Returns the number of tasks that were posted and did not finish yet
+    std::size_t pending()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pending;
+    }
+
+    /// @brief Blocks until all posted tasks finished
+    void wait_idle()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this]() { return m_pending == 0; });
+    }
+
+private:
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        for (;;) {
+            m_workAvailable.wait(lock, [this]() { return !m_ready.empty() || m_stopping; });
+            if (m_ready.empty()) {
+                return;
+            }
+
+            const std::size_t key = m_ready.front();
+            m_ready.pop_front();
+
+            // the strand stays active while its task runs, so no other worker picks it up
+            std::function<void()> task = std::move(m_strands[key].tasks.front());
+            m_strands[key].tasks.pop_front();
+
+            lock.unlock();
+            try {
+                task();
+            } catch (const std::exception &e) {
+                std::cerr << "Exception in signal callback: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "Exception in signal callback" << std::endl;
+            }
+            task = nullptr;
+            lock.lock();
+
+            // one task per turn, so busy strands don't starve the others
+            Strand &strand = m_strands[key];
+            if (strand.tasks.empty()) {
+                m_strands.erase(key);
+            } else {
+                m_ready.push_back(key);
+                m_workAvailable.notify_one();
+            }
+
+            --m_pending;
+            m_spaceAvailable.notify_one();
+            if (m_pending == 0) {
+                m_idle.notify_all();
+            }
+        }
+    }
+};
+
+}
+
+#endif // SIGNAL_DISPATCHER_H
@@ -0,0 +1,140 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace WebChannelPP
+{
+
+/// @brief Hashed timer wheel for large numbers of deadlines.
+///
+/// Deadlines are rounded up to ticks of `resolution()` and hashed into a fixed number of
+/// buckets by their tick, so scheduling is O(1) and `advance()` only looks at the buckets of
+/// the ticks that passed. Timers cannot be cancelled; the owner is expected to ignore keys
+/// that completed in the meantime, which keeps scheduling free of bookkeeping.
+template<class Key>
+class TimerWheel
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+private:
+    struct Timer
+    {
+        std::uint64_t tick;
+        Key key;
+    };
+
+    clock::time_point m_origin;
+    clock::duration m_resolution;
+    std::vector<std::vector<Timer>> m_buckets;
+    std::size_t m_mask;
+    std::uint64_t m_currentTick = 0;
+    std::size_t m_size = 0;
+    std::vector<Key> m_expired;
+
+public:
+    /// @param resolution Granularity of deadlines
+    /// @param buckets Number of buckets, rounded up to a power of two. Deadlines further away
+    ///                than `buckets * resolution` are fine, but are looked at more than once.
+    explicit TimerWheel(std::chrono::milliseconds resolution = std::chrono::milliseconds(10),
+                        std::size_t buckets = 512, clock::time_point now = clock::now())
+        : m_origin(now), m_resolution(resolution)
+    {
+        std::size_t count = 1;
+        while (count < buckets) {
+            count *= 2;
+        }
+        m_buckets.resize(count);
+        m_mask = count - 1;
+    }
+
+    clock::duration resolution() const { return m_resolution; }
+
+    /// @brief Returns the number of scheduled timers, including those of completed keys
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /// @brief Schedules @p key to expire at @p deadline
+    void schedule(Key key, clock::time_point deadline)
+    {
+        std::uint64_t tick = m_currentTick + 1;
+        if (deadline > m_origin) {
+            // round up, a timer never fires early
+            const auto elapsed = deadline - m_origin;
+            const std::uint64_t deadlineTick = std::uint64_t((elapsed + m_resolution - clock::duration(1)) / m_resolution);
+            if (deadlineTick > tick) {
+                tick = deadlineTick;
+            }
+        }
+
+        m_buckets[tick & m_mask].push_back(Timer { tick, std::move(key) });
+        ++m_size;
+    }
+
+    /// @brief Calls @p expired with the key of each timer whose deadline is at or before @p now
+    /// @return The number of expired timers
+    template<class Handler>
+    std::size_t advance(clock::time_point now, Handler &&expired)
+    {
+        if (now <= m_origin) {
+            return 0;
+        }
+
+        const std::uint64_t target = std::uint64_t((now - m_origin) / m_resolution);
+        if (target <= m_currentTick) {
+            return 0;
+        }
+
+        // after a full revolution, every bucket has been looked at
+        const std::uint64_t ticks = target - m_currentTick;
+        const std::uint64_t steps = ticks < m_buckets.size() ? ticks : m_buckets.size();
+
+        m_expired.clear();
+        for (std::uint64_t i = 1; i <= steps; ++i) {
+            std::vector<Timer> &bucket = m_buckets[(m_currentTick + i) & m_mask];
+            for (std::size_t j = 0; j < bucket.size();) {
+                if (bucket[j].tick > target) {
+                    ++j;
+                    continue;
+                }
+                m_expired.push_back(std::move(bucket[j].key));
+                if (j + 1 != bucket.size()) {
+                    bucket[j] = std::move(bucket.back());
+                }
+                bucket.pop_back();
+            }
+        }
+        m_currentTick = target;
+        m_size -= m_expired.size();
+
+        // handlers may schedule new timers or advance the wheel again, so only call them
+        // once the buckets are consistent, and from a list of their own
+        std::vector<Key> keys;
+        keys.swap(m_expired);
+        for (const Key &key : keys) {
+            expired(key);
+        }
+
+        const std::size_t count = keys.size();
+        keys.clear();
+        if (keys.capacity() > m_expired.capacity()) {
+            m_expired.swap(keys);
+        }
+        return count;
+    }
+};
+
+}
+
+#endif // TIMER_WHEEL_H
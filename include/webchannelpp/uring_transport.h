@@ -0,0 +1,678 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef URING_TRANSPORT_H
+#define URING_TRANSPORT_H
+
+#ifndef __linux__
+#error "uring_transport.h requires Linux"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "qwebchannel_fwd.h"
+#include "buffer_pool.h"
+#include "framing.h"
+#include "receive_buffer.h"
+#include "wire_format.h"
+
+namespace WebChannelPP
+{
+
+namespace detail
+{
+
+inline int io_uring_setup(unsigned entries, io_uring_params *params)
+{
+    return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+inline int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return int(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+inline int io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nrArgs)
+{
+    return int(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+/// @brief Receiver of io_uring completions, identified by the id `UringLoop::add()` gave it
+class UringCompletion
+{
+public:
+    virtual void complete(int result, std::uint32_t flags) = 0;
+
+protected:
+    ~UringCompletion() = default;
+};
+
+template<class T>
+std::atomic<T> *ring_field(void *base, std::uint32_t offset)
+{
+    return reinterpret_cast<std::atomic<T>*>(static_cast<char*>(base) + offset);
+}
+
+}
+
+/// @brief An io_uring instance shared by many transports.
+///
+/// Receives use multishot recv requests that pick their memory from a ring of buffers
+/// provided to the kernel once, so one armed request per connection delivers data for its
+/// whole lifetime and no buffer is passed per read. A single `io_uring_enter()` call submits
+/// the requests of all transports and reaps their completions.
+///
+/// The loop is single-threaded: transports must only be used from the thread calling `run()`
+/// or `run_once()`. Requires Linux 6.0 or newer.
+class UringLoop
+{
+    static constexpr std::uint16_t buffer_group = 0;
+
+    int m_fd = -1;
+    io_uring_params m_params;
+
+    void *m_sqRing = MAP_FAILED;
+    void *m_cqRing = MAP_FAILED;
+    std::size_t m_sqRingSize = 0;
+    std::size_t m_cqRingSize = 0;
+    io_uring_sqe *m_sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+
+    std::atomic<std::uint32_t> *m_sqTail = nullptr;
+    std::uint32_t m_sqMask = 0;
+    std::uint32_t *m_sqArray = nullptr;
+    std::atomic<std::uint32_t> *m_sqHead = nullptr;
+    std::atomic<std::uint32_t> *m_cqHead = nullptr;
+    std::atomic<std::uint32_t> *m_cqTail = nullptr;
+    std::uint32_t m_cqMask = 0;
+    io_uring_cqe *m_cqes = nullptr;
+    std::uint32_t m_pending = 0;
+
+    void *m_bufferRing = MAP_FAILED;
+    std::size_t m_bufferRingSize = 0;
+    std::vector<char> m_buffers;
+    std::uint32_t m_bufferCount;
+    std::uint32_t m_bufferSize;
+    std::uint16_t m_bufferTail = 0;
+
+    // receivers by the id in `user_data`. Ids are never reused, so a completion that arrives
+    // after its receiver was removed is not delivered to another one at the same address.
+    std::unordered_map<std::uint64_t, detail::UringCompletion*> m_live;
+    std::uint64_t m_nextId = 1;
+    bool m_stopped = false;
+
+public:
+    /// @brief Sets up a ring with @p entries submission slots and @p bufferCount receive buffers
+    ///        of @p bufferSize bytes each. @p bufferCount must be a power of two.
+    ///        Throws std::system_error if the kernel refuses.
+    explicit UringLoop(unsigned entries = 256, std::uint32_t bufferCount = 256, std::uint32_t bufferSize = 16 * 1024)
+        : m_buffers(std::size_t(bufferCount) * bufferSize), m_bufferCount(bufferCount), m_bufferSize(bufferSize)
+    {
+        std::memset(&m_params, 0, sizeof(m_params));
+        m_fd = detail::io_uring_setup(entries, &m_params);
+        if (m_fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+        }
+
+        try {
+            map_rings();
+            setup_buffer_ring();
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    UringLoop(const UringLoop &) = delete;
+    UringLoop &operator=(const UringLoop &) = delete;
+
+    ~UringLoop()
+    {
+        unmap();
+    }
+
+    /// @brief Submits queued requests and dispatches completions.
+    ///        If @p wait is true, blocks until at least one completion arrived.
+    /// @return The number of dispatched completions
+    std::size_t run_once(bool wait = true)
+    {
+        const int ret = detail::io_uring_enter(m_fd, m_pending, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            std::cerr << "io_uring_enter failed: " << std::strerror(errno) << std::endl;
+            return 0;
+        }
+        if (ret > 0) {
+            m_pending -= std::uint32_t(ret) < m_pending ? std::uint32_t(ret) : m_pending;
+        }
+
+        return reap();
+    }
+
+    /// @brief Dispatches completions until `stop()` is called, which may happen before `run()`
+    void run()
+    {
+        while (!m_stopped) {
+            run_once();
+        }
+        m_stopped = false;
+    }
+
+    void stop()
+    {
+        m_stopped = true;
+    }
+
+    std::uint32_t buffer_size() const { return m_bufferSize; }
+
+private:
+    template<class Framing>
+    friend class BasicUringTransport;
+
+    /// @brief Returns a free submission slot. Throws std::system_error if the kernel refuses requests.
+    io_uring_sqe *next_sqe()
+    {
+        std::uint32_t tail;
+        // the tail is reloaded after reaping, whose handlers may have queued requests themselves
+        while ((tail = m_sqTail->load(std::memory_order_relaxed)) - m_sqHead->load(std::memory_order_acquire) > m_sqMask) {
+            // submission queue full, hand the queued requests to the kernel first
+            const int ret = detail::io_uring_enter(m_fd, m_pending, 0, IORING_ENTER_GETEVENTS);
+            if (ret > 0) {
+                m_pending -= std::uint32_t(ret) < m_pending ? std::uint32_t(ret) : m_pending;
+            } else if (ret < 0 && (errno == EBUSY || errno == EAGAIN)) {
+                // the completion queue is full, the kernel takes no requests until it is reaped
+                reap();
+            } else if (ret < 0 && errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+            }
+        }
+
+        const std::uint32_t index = tail & m_sqMask;
+        io_uring_sqe *sqe = &m_sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        m_sqArray[index] = index;
+        m_sqTail->store(tail + 1, std::memory_order_release);
+        m_pending++;
+        return sqe;
+    }
+
+    void submit_recv(int fd, std::uint64_t id)
+    {
+        io_uring_sqe *sqe = next_sqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = buffer_group;
+        sqe->user_data = id;
+    }
+
+    void submit_sendmsg(int fd, const msghdr *msg, std::uint64_t id)
+    {
+        io_uring_sqe *sqe = next_sqe();
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<std::uintptr_t>(msg);
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = id;
+    }
+
+    void submit_cancel(std::uint64_t id)
+    {
+        io_uring_sqe *sqe = next_sqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = id;
+        sqe->user_data = 0;
+    }
+
+    /// @brief Registers @p completion and returns the id its requests are submitted with
+    std::uint64_t add(detail::UringCompletion *completion)
+    {
+        const std::uint64_t id = m_nextId++;
+        m_live.emplace(id, completion);
+        return id;
+    }
+
+    void remove(std::uint64_t id) { m_live.erase(id); }
+
+    /// @brief Returns the data of provided buffer @p id
+    const char *buffer(std::uint16_t id) const { return m_buffers.data() + std::size_t(id) * m_bufferSize; }
+
+    /// @brief Hands provided buffer @p id back to the kernel
+    void recycle_buffer(std::uint16_t id)
+    {
+        io_uring_buf *bufs = static_cast<io_uring_buf*>(m_bufferRing);
+        io_uring_buf &buf = bufs[m_bufferTail & (m_bufferCount - 1)];
+        buf.addr = reinterpret_cast<std::uintptr_t>(buffer(id));
+        buf.len = m_bufferSize;
+        buf.bid = id;
+        m_bufferTail++;
+        detail::ring_field<std::uint16_t>(m_bufferRing, offsetof(io_uring_buf, resv))
+                ->store(m_bufferTail, std::memory_order_release);
+    }
+
+    std::size_t reap()
+    {
+        std::size_t count = 0;
+
+        // the head is reloaded for every entry: handlers may submit requests, and `next_sqe()`
+        // reaps from within them while the submission queue is full
+        for (;; ++count) {
+            const std::uint32_t head = m_cqHead->load(std::memory_order_relaxed);
+            if (head == m_cqTail->load(std::memory_order_acquire)) {
+                break;
+            }
+            const io_uring_cqe cqe = m_cqes[head & m_cqMask];
+            // release the slot before dispatching
+            m_cqHead->store(head + 1, std::memory_order_release);
+
+            const auto it = cqe.user_data ? m_live.find(cqe.user_data) : m_live.end();
+            if (it != m_live.end()) {
+                it->second->complete(cqe.res, cqe.flags);
+            } else if (cqe.flags & IORING_CQE_F_BUFFER) {
+                // data for a transport that is gone
+                recycle_buffer(std::uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+        }
+
+        return count;
+    }
+
+    void map_rings()
+    {
+        m_sqRingSize = m_params.sq_off.array + m_params.sq_entries * sizeof(std::uint32_t);
+        m_cqRingSize = m_params.cq_off.cqes + m_params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMmap = m_params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+
+        m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap io_uring sq");
+        }
+        m_cqRing = singleMmap ? m_sqRing : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap io_uring cq");
+        }
+        void *sqes = mmap(nullptr, m_params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap io_uring sqes");
+        }
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+        m_sqHead = detail::ring_field<std::uint32_t>(m_sqRing, m_params.sq_off.head);
+        m_sqTail = detail::ring_field<std::uint32_t>(m_sqRing, m_params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<std::uint32_t*>(static_cast<char*>(m_sqRing) + m_params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<std::uint32_t*>(static_cast<char*>(m_sqRing) + m_params.sq_off.array);
+        m_cqHead = detail::ring_field<std::uint32_t>(m_cqRing, m_params.cq_off.head);
+        m_cqTail = detail::ring_field<std::uint32_t>(m_cqRing, m_params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<std::uint32_t*>(static_cast<char*>(m_cqRing) + m_params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(m_cqRing) + m_params.cq_off.cqes);
+    }
+
+    void setup_buffer_ring()
+    {
+        if (m_bufferCount == 0 || (m_bufferCount & (m_bufferCount - 1)) || m_bufferCount > 32768) {
+            throw std::system_error(EINVAL, std::generic_category(), "io_uring buffer count must be a power of two");
+        }
+
+        m_bufferRingSize = m_bufferCount * sizeof(io_uring_buf);
+        m_bufferRing = mmap(nullptr, m_bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m_bufferRing == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap io_uring buffer ring");
+        }
+
+        io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<std::uintptr_t>(m_bufferRing);
+        reg.ring_entries = m_bufferCount;
+        reg.bgid = buffer_group;
+        if (detail::io_uring_register(m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            throw std::system_error(errno, std::generic_category(), "io_uring_register pbuf ring");
+        }
+
+        for (std::uint32_t id = 0; id < m_bufferCount; ++id) {
+            recycle_buffer(std::uint16_t(id));
+        }
+    }
+
+    void unmap()
+    {
+        if (m_bufferRing != MAP_FAILED) {
+            munmap(m_bufferRing, m_bufferRingSize);
+        }
+        if (m_sqes != MAP_FAILED) {
+            munmap(m_sqes, m_params.sq_entries * sizeof(io_uring_sqe));
+        }
+        if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        if (m_sqRing != MAP_FAILED) {
+            munmap(m_sqRing, m_sqRingSize);
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+};
+
+/// @brief Transport over a connected stream socket, driven by a UringLoop.
+///
+/// The socket file descriptor is not owned by the transport. The `Framing` policy is the
+/// same as for BasicAsioTransport.
+template<class Framing = NewlineFraming>
+class BasicUringTransport : public Transport
+{
+    struct OutgoingMessage
+    {
+        typename Framing::header_type header;
+        std::string payload;
+    };
+
+    struct Receiver : detail::UringCompletion
+    {
+        BasicUringTransport *transport;
+        void complete(int result, std::uint32_t flags) override { transport->recv_done(result, flags); }
+    };
+
+    struct Sender : detail::UringCompletion
+    {
+        BasicUringTransport *transport;
+        void complete(int result, std::uint32_t) override { transport->send_done(result); }
+    };
+
+    static constexpr std::size_t max_gathered_messages = 32;
+
+    UringLoop &m_loop;
+    int m_fd;
+    Receiver m_receiver;
+    Sender m_sender;
+    std::uint64_t m_receiverId;
+    std::uint64_t m_senderId;
+    bool m_receiving = false;
+    bool m_failed = false;
+
+    ReceiveBuffer m_buffer;
+    std::size_t m_maxFrameSize = 64 * 1024 * 1024;
+    message_handler m_handler;
+    serialized_message_handler m_serializedHandler;
+    BasicMessageEncoder<nlohmann::json> m_encoder;
+
+    std::deque<OutgoingMessage> m_outbox;
+    BufferPool m_pool;
+    // bytes of the front message that have already been sent
+    std::size_t m_frontOffset = 0;
+    std::vector<iovec> m_iovecs;
+    msghdr m_msghdr;
+    bool m_sending = false;
+
+public:
+    BasicUringTransport(UringLoop &loop, int fd)
+        : m_loop(loop), m_fd(fd)
+    {
+        m_receiver.transport = this;
+        m_sender.transport = this;
+        m_receiverId = m_loop.add(&m_receiver);
+        m_senderId = m_loop.add(&m_sender);
+
+        arm_recv();
+    }
+
+    BasicUringTransport(const BasicUringTransport &) = delete;
+    BasicUringTransport &operator=(const BasicUringTransport &) = delete;
+
+    /// @note A send that is still in flight keeps referring to the queued data, so only destroy
+    ///       the transport once its socket is closed or its queue has drained.
+    ~BasicUringTransport()
+    {
+        m_loop.remove(m_receiverId);
+        m_loop.remove(m_senderId);
+        if (m_receiving) {
+            // destructors must not throw. The completion of the receive finds no handler anymore,
+            // so if cancelling fails, the request just stays with the kernel until the socket is closed.
+            try {
+                m_loop.submit_cancel(m_receiverId);
+            } catch (const std::system_error &e) {
+                std::cerr << "Failed to cancel receive: " << e.what() << std::endl;
+            }
+        }
+    }
+
+    std::size_t max_frame_size() const { return m_maxFrameSize; }
+    /// @brief Sets the size of the largest incoming message. A peer announcing or sending a larger
+    ///        one is considered broken or hostile: the socket is shut down and receiving stops.
+    void set_max_frame_size(std::size_t bytes) { m_maxFrameSize = bytes; }
+
+    WireFormat wire_format() const { return m_encoder.format(); }
+
+    /// @return false if @p format is binary but the framing cannot carry binary payloads
+    bool set_wire_format(WireFormat format)
+    {
+        if (is_binary(format) && !Framing::binary_safe) {
+            std::cerr << "Binary wire formats require a binary-safe framing" << std::endl;
+            return false;
+        }
+
+        m_encoder.set_format(format);
+        return true;
+    }
+
+    /// @brief Queues @p s. It is submitted with the next `UringLoop::run_once()`.
+    void send(const nlohmann::json &s) override
+    {
+        std::string payload = m_pool.acquire();
+        m_encoder.encode(s, payload);
+        enqueue(std::move(payload));
+    }
+
+    bool accepts_serialized() const override { return !is_binary(m_encoder.format()); }
+
+    void send_serialized(std::string &&message) override
+    {
+        if (is_binary(m_encoder.format())) {
+            std::string payload = m_pool.acquire();
+            m_encoder.encode(nlohmann::json::parse(message), payload);
+            m_pool.release(std::move(message));
+            enqueue(std::move(payload));
+            return;
+        }
+
+        enqueue(std::move(message));
+    }
+
+    std::string acquire_buffer() override { return m_pool.acquire(); }
+
+    void register_message_handler(message_handler handler) override
+    {
+        m_handler = std::move(handler);
+    }
+
+    /// @brief Messages in the JSON wire format are passed to @p handler without being parsed
+    bool register_serialized_message_handler(serialized_message_handler handler) override
+    {
+        m_serializedHandler = std::move(handler);
+        return true;
+    }
+
+private:
+    void enqueue(std::string &&payload)
+    {
+        if (payload.size() > Framing::max_payload_size) {
+            std::cerr << "Cannot send a message of " << payload.size() << " bytes with this framing" << std::endl;
+            m_pool.release(std::move(payload));
+            return;
+        }
+
+        m_outbox.emplace_back();
+        OutgoingMessage &message = m_outbox.back();
+        message.payload = std::move(payload);
+        Framing::write_header(message.header, message.payload.size());
+
+        if (!m_sending) {
+            submit_send();
+        }
+    }
+
+    void arm_recv()
+    {
+        m_loop.submit_recv(m_fd, m_receiverId);
+        m_receiving = true;
+    }
+
+    void recv_done(int result, std::uint32_t flags)
+    {
+        if (flags & IORING_CQE_F_BUFFER) {
+            const std::uint16_t id = std::uint16_t(flags >> IORING_CQE_BUFFER_SHIFT);
+            if (result > 0 && !m_failed) {
+                m_buffer.append(m_loop.buffer(id), std::size_t(result));
+            }
+            m_loop.recycle_buffer(id);
+        }
+
+        if (!(flags & IORING_CQE_F_MORE)) {
+            m_receiving = false;
+
+            // the kernel ran out of provided buffers; they have been recycled meanwhile
+            if (m_failed) {
+                // receiving stopped for good, see check_frame_size()
+            } else if (result == -ENOBUFS || result > 0) {
+                arm_recv();
+            } else if (result < 0 && result != -ECANCELED) {
+                std::cerr << "Stopped reading: " << std::strerror(-result) << std::endl;
+            }
+        }
+
+        if (result > 0 && !m_failed) {
+            process_messages();
+            check_frame_size();
+        }
+    }
+
+    void check_frame_size()
+    {
+        const std::size_t pending = Framing::pending_frame_size(m_buffer);
+        if (pending <= m_maxFrameSize) {
+            return;
+        }
+
+        std::cerr << "Incoming message of " << pending << " bytes exceeds the maximum of "
+                  << m_maxFrameSize << " bytes, closing connection" << std::endl;
+        m_failed = true;
+        m_buffer.consume(m_buffer.size());
+        shutdown(m_fd, SHUT_RDWR);
+        if (m_receiving) {
+            m_loop.submit_cancel(m_receiverId);
+        }
+    }
+
+    void submit_send()
+    {
+        const std::size_t count = m_outbox.size() < max_gathered_messages ? m_outbox.size() : max_gathered_messages;
+
+        m_iovecs.clear();
+        std::size_t skip = m_frontOffset;
+        for (std::size_t i = 0; i < count; ++i) {
+            OutgoingMessage &message = m_outbox[i];
+            add_iovec(message.header.data(), Framing::header_size, skip);
+            add_iovec(&message.payload[0], message.payload.size(), skip);
+            add_iovec(Framing::trailer(), Framing::trailer_size, skip);
+        }
+
+        std::memset(&m_msghdr, 0, sizeof(m_msghdr));
+        m_msghdr.msg_iov = m_iovecs.data();
+        m_msghdr.msg_iovlen = m_iovecs.size();
+
+        m_loop.submit_sendmsg(m_fd, &m_msghdr, m_senderId);
+        m_sending = true;
+    }
+
+    void add_iovec(const char *data, std::size_t size, std::size_t &skip)
+    {
+        if (skip >= size) {
+            skip -= size;
+            return;
+        }
+        m_iovecs.push_back(iovec { const_cast<char*>(data) + skip, size - skip });
+        skip = 0;
+    }
+
+    void send_done(int result)
+    {
+        m_sending = false;
+
+        if (result < 0) {
+            std::cerr << "Failed to send message: " << std::strerror(-result) << std::endl;
+            return;
+        }
+
+        // drop what has been sent; a partially sent message stays at the front
+        std::size_t sent = m_frontOffset + std::size_t(result);
+        while (!m_outbox.empty()) {
+            const std::size_t size = Framing::header_size + m_outbox.front().payload.size() + Framing::trailer_size;
+            if (sent < size) {
+                break;
+            }
+            sent -= size;
+            m_pool.release(std::move(m_outbox.front().payload));
+            m_outbox.pop_front();
+        }
+        m_frontOffset = sent;
+
+        if (!m_outbox.empty()) {
+            submit_send();
+        }
+    }
+
+    void process_messages()
+    {
+        FrameView frame;
+        while (Framing::next_frame(m_buffer, frame)) {
+            if (m_serializedHandler && !is_binary(m_encoder.format())) {
+                m_serializedHandler(frame.data, frame.size);
+                continue;
+            }
+
+            if (!m_handler) {
+                continue;
+            }
+
+            nlohmann::json msg;
+            try {
+                msg = decode_message<nlohmann::json>(frame.data, frame.size, m_encoder.format());
+            } catch (const nlohmann::json::exception &e) {
+                std::cerr << "Invalid message received: " << e.what() << std::endl;
+                continue;
+            }
+
+            m_handler(msg);
+        }
+    }
+};
+
+using UringTransport = BasicUringTransport<>;
+using LengthPrefixedUringTransport = BasicUringTransport<LengthPrefixedFraming>;
+
+}
+
+#endif // URING_TRANSPORT_H
@@ -0,0 +1,641 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef WEBSOCKET_TRANSPORT_H
+#define WEBSOCKET_TRANSPORT_H
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <asio.hpp>
+
+#include "qwebchannel_fwd.h"
+#include "buffer_pool.h"
+#include "receive_buffer.h"
+#include "wire_format.h"
+
+namespace WebChannelPP
+{
+
+namespace detail
+{
+
+inline std::array<std::uint8_t, 20> sha1(const std::string &input)
+{
+    std::uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+    std::string msg = input;
+    const std::uint64_t bitLength = std::uint64_t(input.size()) * 8;
+    msg.push_back(char(0x80));
+    while (msg.size() % 64 != 56) {
+        msg.push_back(char(0));
+    }
+    for (int i = 7; i >= 0; --i) {
+        msg.push_back(char(bitLength >> (i * 8)));
+    }
+
+    auto rotl = [](std::uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+
+    for (std::size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+        std::uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const unsigned char *p = reinterpret_cast<const unsigned char*>(msg.data() + chunk + i * 4);
+            w[i] = (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) | (std::uint32_t(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            std::uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            const std::uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::array<std::uint8_t, 20> digest;
+    for (int i = 0; i < 20; ++i) {
+        digest[i] = std::uint8_t(h[i / 4] >> (24 - (i % 4) * 8));
+    }
+    return digest;
+}
+
+inline std::string base64_encode(const std::uint8_t *data, std::size_t size)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string out;
+    out.reserve((size + 2) / 3 * 4);
+    for (std::size_t i = 0; i < size; i += 3) {
+        const std::uint32_t n = (std::uint32_t(data[i]) << 16) |
+                                (i + 1 < size ? std::uint32_t(data[i + 1]) << 8 : 0) |
+                                (i + 2 < size ? std::uint32_t(data[i + 2]) : 0);
+        out.push_back(alphabet[(n >> 18) & 63]);
+        out.push_back(alphabet[(n >> 12) & 63]);
+        out.push_back(i + 1 < size ? alphabet[(n >> 6) & 63] : '=');
+        out.push_back(i + 2 < size ? alphabet[n & 63] : '=');
+    }
+    return out;
+}
+
+/// @brief XORs @p size bytes at @p data with the WebSocket masking key @p mask.
+///
+/// Works on 8 bytes at a time, which compilers turn into vector instructions.
+inline void apply_websocket_mask(char *data, std::size_t size, const std::array<char, 4> &mask)
+{
+    std::uint64_t wideMask;
+    for (std::size_t i = 0; i < sizeof(wideMask); i += 4) {
+        std::memcpy(reinterpret_cast<char*>(&wideMask) + i, mask.data(), 4);
+    }
+
+    std::size_t i = 0;
+    for (; i + sizeof(wideMask) <= size; i += sizeof(wideMask)) {
+        std::uint64_t chunk;
+        std::memcpy(&chunk, data + i, sizeof(chunk));
+        chunk ^= wideMask;
+        std::memcpy(data + i, &chunk, sizeof(chunk));
+    }
+    for (; i < size; ++i) {
+        data[i] ^= mask[i % 4];
+    }
+}
+
+}
+
+/// @brief Client transport speaking the WebSocket protocol (RFC 6455) over an asio TCP socket.
+///
+/// This is what QWebSocketServer based hosts expect. The opening handshake is sent on
+/// construction; messages sent before it completes are queued.
+///
+/// Like BasicAsioTransport, all completion handlers run on the strand of the transport, and the
+/// attached channel is only safe to use from handlers passed to `post()`.
+class WebSocketTransport : public Transport
+{
+public:
+    typedef asio::strand<asio::ip::tcp::socket::executor_type> strand_type;
+
+    /// Close status sent when a message exceeds the configured limits
+    static constexpr std::uint16_t message_too_big = 1009;
+    /// Close status sent when the server violates the protocol, e.g. with a fragmented control frame
+    static constexpr std::uint16_t protocol_error = 1002;
+
+private:
+    enum Opcode {
+        Continuation = 0x0,
+        Text = 0x1,
+        Binary = 0x2,
+        Close = 0x8,
+        Ping = 0x9,
+        Pong = 0xA,
+    };
+
+    struct OutgoingFrame
+    {
+        std::array<char, 14> header;
+        std::size_t headerSize;
+        std::string payload;
+    };
+
+    static constexpr std::size_t max_gathered_frames = 32;
+
+    asio::ip::tcp::socket &m_socket;
+    strand_type m_strand;
+    ReceiveBuffer m_buffer;
+    std::size_t m_readSize = 4096;
+    std::size_t m_maxFrameSize = 64 * 1024 * 1024;
+    std::size_t m_maxMessageSize = 64 * 1024 * 1024;
+    message_handler m_handler;
+    serialized_message_handler m_serializedHandler;
+    BasicMessageEncoder<nlohmann::json> m_encoder;
+
+    std::string m_handshakeRequest;
+    std::string m_expectedAccept;
+    bool m_open = false;
+    bool m_closing = false;
+    // a limit was exceeded; incoming data is dropped until the server closes the connection
+    bool m_failed = false;
+
+    std::string m_fragments;
+    bool m_fragmented = false;
+
+    std::deque<OutgoingFrame> m_outbox;
+    BufferPool m_pool;
+    std::vector<asio::const_buffer> m_gather;
+    std::size_t m_inFlight = 0;
+    // nonces and masking keys must not be predictable by anyone on the path, RFC 6455 section 10.3
+    std::random_device m_random;
+
+public:
+    /// @brief Starts the opening handshake for the resource @p path on @p host over the
+    ///        already connected @p socket.
+    WebSocketTransport(asio::ip::tcp::socket &socket, const std::string &host, const std::string &path = "/")
+        : m_socket(socket), m_strand(socket.get_executor())
+    {
+        std::array<std::uint8_t, 16> nonce;
+        for (std::size_t i = 0; i < nonce.size(); i += 4) {
+            const std::uint32_t bits = m_random();
+            std::memcpy(&nonce[i], &bits, 4);
+        }
+        const std::string key = detail::base64_encode(nonce.data(), nonce.size());
+        const auto accept = detail::sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+        m_expectedAccept = detail::base64_encode(accept.data(), accept.size());
+
+        m_handshakeRequest = "GET " + path + " HTTP/1.1\r\n"
+                             "Host: " + host + "\r\n"
+                             "Upgrade: websocket\r\n"
+                             "Connection: Upgrade\r\n"
+                             "Sec-WebSocket-Key: " + key + "\r\n"
+                             "Sec-WebSocket-Version: 13\r\n"
+                             "\r\n";
+
+        asio::async_write(m_socket, asio::buffer(m_handshakeRequest),
+                          asio::bind_executor(m_strand, [this](const asio::error_code &err, std::size_t) {
+            if (err) {
+                std::cerr << "WebSocket handshake failed: " << err.message() << std::endl;
+            }
+        }));
+
+        async_read_more();
+    }
+
+    /// @brief Returns the strand all handlers of this transport run on
+    const strand_type &strand() const { return m_strand; }
+
+    /// @brief Runs @p handler on the strand of this transport, e.g. to use the attached channel
+    ///        from another thread
+    template<class Handler>
+    void post(Handler &&handler)
+    {
+        asio::post(m_strand, std::forward<Handler>(handler));
+    }
+
+    /// @brief Returns whether the opening handshake has completed
+    bool is_open() const { return m_open; }
+
+    std::size_t max_frame_size() const { return m_maxFrameSize; }
+    /// @brief Sets the largest payload of a single incoming frame
+    void set_max_frame_size(std::size_t bytes) { m_maxFrameSize = bytes; }
+
+    std::size_t max_message_size() const { return m_maxMessageSize; }
+    /// @brief Sets the largest incoming message, summed over all of its fragments.
+    ///        Exceeding either limit closes the connection with status 1009.
+    void set_max_message_size(std::size_t bytes) { m_maxMessageSize = bytes; }
+
+    WireFormat wire_format() const { return m_encoder.format(); }
+    /// @brief Selects the encoding of messages. JSON is sent in text frames, binary formats in binary frames.
+    void set_wire_format(WireFormat format) { m_encoder.set_format(format); }
+
+    void send(const nlohmann::json &s) override
+    {
+        if (m_closing) {
+            return;
+        }
+
+        std::string payload = m_pool.acquire();
+        m_encoder.encode(s, payload);
+        send_frame(std::move(payload));
+    }
+
+    bool accepts_serialized() const override { return !is_binary(m_encoder.format()); }
+
+    void send_serialized(std::string &&message) override
+    {
+        if (m_closing) {
+            return;
+        }
+
+        if (is_binary(m_encoder.format())) {
+            std::string payload = m_pool.acquire();
+            m_encoder.encode(nlohmann::json::parse(message), payload);
+            m_pool.release(std::move(message));
+            send_frame(std::move(payload));
+            return;
+        }
+
+        send_frame(std::move(message));
+    }
+
+    std::string acquire_buffer() override { return m_pool.acquire(); }
+
+    void register_message_handler(message_handler handler) override
+    {
+        m_handler = std::move(handler);
+    }
+
+    /// @brief Messages in the JSON wire format are passed to @p handler without being parsed
+    bool register_serialized_message_handler(serialized_message_handler handler) override
+    {
+        m_serializedHandler = std::move(handler);
+        return true;
+    }
+
+    /// @brief Starts the closing handshake with the given status @p code
+    void close(std::uint16_t code = 1000)
+    {
+        if (m_closing) {
+            return;
+        }
+
+        m_outbox.emplace_back();
+        OutgoingFrame &frame = m_outbox.back();
+        frame.payload.push_back(char(code >> 8));
+        frame.payload.push_back(char(code));
+        write_frame_header(frame, Close);
+        m_closing = true;
+
+        start_write();
+    }
+
+private:
+    void send_frame(std::string &&payload)
+    {
+        m_outbox.emplace_back();
+        OutgoingFrame &frame = m_outbox.back();
+        frame.payload = std::move(payload);
+        write_frame_header(frame, is_binary(m_encoder.format()) ? Binary : Text);
+
+        start_write();
+    }
+
+    void write_frame_header(OutgoingFrame &frame, Opcode opcode)
+    {
+        const std::size_t size = frame.payload.size();
+        char *header = frame.header.data();
+
+        header[0] = char(0x80 | opcode);
+        std::size_t pos = 2;
+        if (size < 126) {
+            header[1] = char(0x80 | size);
+        } else if (size <= 0xFFFF) {
+            header[1] = char(0x80 | 126);
+            header[pos++] = char(size >> 8);
+            header[pos++] = char(size);
+        } else {
+            header[1] = char(0x80 | 127);
+            for (int i = 7; i >= 0; --i) {
+                header[pos++] = char(std::uint64_t(size) >> (i * 8));
+            }
+        }
+
+        // clients must mask every frame; the payload is ours, so mask it in place
+        std::array<char, 4> mask;
+        const std::uint32_t key = m_random();
+        std::memcpy(mask.data(), &key, mask.size());
+        std::memcpy(header + pos, mask.data(), mask.size());
+        pos += mask.size();
+
+        detail::apply_websocket_mask(&frame.payload[0], size, mask);
+        frame.headerSize = pos;
+    }
+
+    void start_write()
+    {
+        if (!m_open || m_inFlight > 0 || m_outbox.empty()) {
+            return;
+        }
+
+        using namespace std::placeholders;
+
+        const std::size_t count = std::min(m_outbox.size(), std::size_t(max_gathered_frames));
+
+        m_gather.clear();
+        for (std::size_t i = 0; i < count; ++i) {
+            m_gather.push_back(asio::buffer(m_outbox[i].header.data(), m_outbox[i].headerSize));
+            m_gather.push_back(asio::buffer(m_outbox[i].payload));
+        }
+        m_inFlight = count;
+
+        asio::async_write(m_socket, m_gather,
+                          asio::bind_executor(m_strand, std::bind(&WebSocketTransport::write_done, this, _1, _2)));
+    }
+
+    void write_done(const asio::error_code &err, std::size_t /* nbytes */)
+    {
+        const std::size_t count = m_inFlight;
+        m_inFlight = 0;
+
+        if (err) {
+            // nothing will be written anymore, so drop the queue and everything sent later
+            std::cerr << "Failed to send message: " << err.message() << std::endl;
+            for (auto &frame : m_outbox) {
+                m_pool.release(std::move(frame.payload));
+            }
+            m_outbox.clear();
+            m_closing = true;
+            return;
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            m_pool.release(std::move(m_outbox[i].payload));
+        }
+        m_outbox.erase(m_outbox.begin(), m_outbox.begin() + count);
+        start_write();
+    }
+
+    void async_read_more()
+    {
+        using namespace std::placeholders;
+        m_socket.async_read_some(asio::buffer(m_buffer.prepare(m_readSize), m_readSize),
+                                 asio::bind_executor(m_strand, std::bind(&WebSocketTransport::read_some, this, _1, _2)));
+    }
+
+    void read_some(const asio::error_code &err, std::size_t nbytes)
+    {
+        if (err) {
+            if (m_closing && err == asio::error::eof) {
+                m_socket.close();
+            } else if (err != asio::error::operation_aborted) {
+                std::cerr << "Stopped reading: " << err.message() << std::endl;
+            }
+            return;
+        }
+
+        m_buffer.commit(nbytes);
+
+        if (m_failed) {
+            m_buffer.consume(m_buffer.size());
+            async_read_more();
+            return;
+        }
+
+        if (!m_open && !process_handshake()) {
+            return;
+        }
+
+        if (m_open) {
+            process_frames();
+        }
+
+        async_read_more();
+    }
+
+    /// @return false if the handshake failed and reading should stop
+    bool process_handshake()
+    {
+        static const char terminator[] = "\r\n\r\n";
+        const char *first = m_buffer.data();
+        const char *last = first + m_buffer.size();
+        const char *end = std::search(first, last, terminator, terminator + 4);
+        if (end == last) {
+            return true;
+        }
+
+        std::string response(first, end);
+        m_buffer.consume(end - first + 4);
+
+        for (char &c : response) {
+            c = char(std::tolower(static_cast<unsigned char>(c)));
+        }
+
+        if (response.compare(0, 12, "http/1.1 101") != 0) {
+            std::cerr << "WebSocket handshake rejected: " << response.substr(0, response.find('\r')) << std::endl;
+            return false;
+        }
+
+        static const std::string acceptHeader = "\r\nsec-websocket-accept:";
+        const std::size_t pos = response.find(acceptHeader);
+        std::string accept;
+        if (pos != std::string::npos) {
+            const std::size_t valueBegin = std::min(response.find_first_not_of(' ', pos + acceptHeader.size()), response.size());
+            const std::size_t valueEnd = std::min(response.find('\r', valueBegin), response.size());
+            // the accept value is base64 and thus case-sensitive, take it from the original bytes
+            accept.assign(first + valueBegin, valueEnd - valueBegin);
+            accept.erase(accept.find_last_not_of(' ') + 1);
+        }
+
+        if (accept != m_expectedAccept) {
+            std::cerr << "WebSocket handshake failed: invalid Sec-WebSocket-Accept" << std::endl;
+            return false;
+        }
+
+        m_open = true;
+        start_write();
+        return true;
+    }
+
+    void process_frames()
+    {
+        while (!m_failed) {
+            const std::size_t available = m_buffer.size();
+            const unsigned char *header = reinterpret_cast<const unsigned char*>(m_buffer.data());
+            if (available < 2) {
+                return;
+            }
+
+            const bool fin = header[0] & 0x80;
+            const int opcode = header[0] & 0x0F;
+            const bool masked = header[1] & 0x80;
+
+            std::size_t headerSize = 2;
+            std::uint64_t length = header[1] & 0x7F;
+            if (length == 126) {
+                headerSize += 2;
+            } else if (length == 127) {
+                headerSize += 8;
+            }
+            if (masked) {
+                headerSize += 4;
+            }
+            if (available < headerSize) {
+                return;
+            }
+
+            if (length >= 126) {
+                const std::size_t lengthBytes = length == 126 ? 2 : 8;
+                length = 0;
+                for (std::size_t i = 0; i < lengthBytes; ++i) {
+                    length = (length << 8) | header[2 + i];
+                }
+            }
+
+            // control frames are never fragmented and fit into the short length form
+            if (opcode >= Close && (!fin || length > 125)) {
+                std::cerr << "Invalid WebSocket control frame, closing connection" << std::endl;
+                fail(protocol_error);
+                return;
+            }
+
+            // checked before the payload is buffered
+            const std::uint64_t messageSize = opcode == Continuation && m_fragmented ? m_fragments.size() + length : length;
+            if (length > m_maxFrameSize || (opcode < Close && messageSize > m_maxMessageSize)) {
+                std::cerr << "Incoming WebSocket message of at least " << messageSize << " bytes exceeds the limits, closing connection" << std::endl;
+                fail(message_too_big);
+                return;
+            }
+
+            if (available - headerSize < length) {
+                return;
+            }
+
+            // servers must not mask, but unmask in place should one do so anyway
+            char *payload = m_buffer.data() + headerSize;
+            if (masked) {
+                std::array<char, 4> mask;
+                std::memcpy(mask.data(), payload - 4, mask.size());
+                detail::apply_websocket_mask(payload, length, mask);
+            }
+
+            const FrameView frame { payload, std::size_t(length) };
+            m_buffer.consume(headerSize + length);
+
+            handle_frame(fin, opcode, frame);
+        }
+    }
+
+    void handle_frame(bool fin, int opcode, const FrameView &frame)
+    {
+        switch (opcode) {
+        case Text:
+        case Binary:
+            if (fin) {
+                deliver(frame);
+            } else {
+                m_fragments.assign(frame.data, frame.size);
+                m_fragmented = true;
+            }
+            break;
+        case Continuation:
+            if (!m_fragmented) {
+                std::cerr << "Unexpected WebSocket continuation frame" << std::endl;
+                break;
+            }
+            m_fragments.append(frame.data, frame.size);
+            if (fin) {
+                m_fragmented = false;
+                deliver(FrameView { m_fragments.data(), m_fragments.size() });
+            }
+            break;
+        case Ping:
+            m_outbox.emplace_back();
+            m_outbox.back().payload.assign(frame.data, frame.size);
+            write_frame_header(m_outbox.back(), Pong);
+            start_write();
+            break;
+        case Pong:
+            break;
+        case Close:
+            if (!m_closing) {
+                // echo the status code as required by the closing handshake
+                m_outbox.emplace_back();
+                m_outbox.back().payload.assign(frame.data, std::min<std::size_t>(frame.size, 2));
+                write_frame_header(m_outbox.back(), Close);
+                m_closing = true;
+                start_write();
+            }
+            // the server closes the TCP connection next, see read_some()
+            break;
+        default:
+            std::cerr << "Unknown WebSocket opcode " << opcode << std::endl;
+            break;
+        }
+    }
+
+    void fail(std::uint16_t code)
+    {
+        m_failed = true;
+        m_fragments.clear();
+        m_fragmented = false;
+        m_buffer.consume(m_buffer.size());
+        close(code);
+    }
+
+    void deliver(const FrameView &frame)
+    {
+        if (m_serializedHandler && !is_binary(m_encoder.format())) {
+            m_serializedHandler(frame.data, frame.size);
+            return;
+        }
+
+        if (!m_handler) {
+            return;
+        }
+
+        nlohmann::json msg;
+        try {
+            msg = decode_message<nlohmann::json>(frame.data, frame.size, m_encoder.format());
+        } catch (const nlohmann::json::exception &e) {
+            std::cerr << "Invalid message received: " << e.what() << std::endl;
+            return;
+        }
+
+        m_handler(msg);
+    }
+};
+
+}
+
+#endif // WEBSOCKET_TRANSPORT_H
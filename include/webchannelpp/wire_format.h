@@ -0,0 +1,165 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <cstddef>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+#ifndef WEBCHANNELPP_USE_GLOBAL_JSON
+#include "nlohmann/json.hpp"
+#else
+#include <json.hpp>
+#endif
+
+namespace WebChannelPP
+{
+
+/// @brief Encoding of messages on the wire.
+///
+/// Qt hosts only speak `Json`. The binary formats are meant for channels where both ends are
+/// under our control, e.g. a local mock host or a proxy translating to JSON.
+enum class WireFormat
+{
+    Json,
+    Cbor,
+    MessagePack,
+    Ubjson,
+};
+
+/// @brief Returns whether messages in @p format may contain arbitrary bytes, including newlines
+inline bool is_binary(WireFormat format)
+{
+    return format != WireFormat::Json;
+}
+
+/// @brief Replaces the contents of @p out with @p value encoded in @p format
+template<class Json>
+void encode_message(const Json &value, WireFormat format, std::string &out)
+{
+    out.clear();
+
+    switch (format) {
+    case WireFormat::Json:
+        out = value.dump();
+        break;
+    case WireFormat::Cbor:
+        Json::to_cbor(value, out);
+        break;
+    case WireFormat::MessagePack:
+        Json::to_msgpack(value, out);
+        break;
+    case WireFormat::Ubjson:
+        Json::to_ubjson(value, out);
+        break;
+    }
+}
+
+/// @brief Encodes messages into caller-provided buffers.
+///
+/// Unlike `encode_message()`, the encoder appends to its output, so one buffer can be reused
+/// for many messages. Only the public interface of nlohmann::json is used: the binary formats
+/// are written straight into the buffer, JSON text through `operator<<` into a stream that
+/// appends to it, so no temporary string is built per value.
+template<class Json>
+class BasicMessageEncoder
+{
+    // appends everything written to the stream to the buffer of the current `encode()` call
+    class AppendBuffer : public std::streambuf
+    {
+        std::string *m_target = nullptr;
+
+    public:
+        void set_target(std::string *target) { m_target = target; }
+
+    protected:
+        int_type overflow(int_type c) override
+        {
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                m_target->push_back(traits_type::to_char_type(c));
+            }
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char *s, std::streamsize count) override
+        {
+            m_target->append(s, std::size_t(count));
+            return count;
+        }
+    };
+
+    WireFormat m_format;
+    AppendBuffer m_buffer;
+    std::ostream m_stream;
+
+public:
+    explicit BasicMessageEncoder(WireFormat format = WireFormat::Json)
+        : m_format(format), m_stream(&m_buffer)
+    {
+    }
+
+    // the stream refers to the buffer of its own encoder, so copies only take the format
+    BasicMessageEncoder(const BasicMessageEncoder &other)
+        : BasicMessageEncoder(other.m_format)
+    {
+    }
+
+    BasicMessageEncoder &operator=(const BasicMessageEncoder &other)
+    {
+        m_format = other.m_format;
+        return *this;
+    }
+
+    WireFormat format() const { return m_format; }
+    void set_format(WireFormat format) { m_format = format; }
+
+    /// @brief Appends @p value encoded in `format()` to @p out
+    void encode(const Json &value, std::string &out)
+    {
+        switch (m_format) {
+        case WireFormat::Json:
+            m_buffer.set_target(&out);
+            m_stream << value;
+            m_buffer.set_target(nullptr);
+            break;
+        case WireFormat::Cbor:
+            Json::to_cbor(value, out);
+            break;
+        case WireFormat::MessagePack:
+            Json::to_msgpack(value, out);
+            break;
+        case WireFormat::Ubjson:
+            Json::to_ubjson(value, out);
+            break;
+        }
+    }
+};
+
+/// @brief Decodes a message in @p format from @p size bytes at @p data.
+///
+/// Throws the exceptions of the respective nlohmann::json parser on malformed input.
+template<class Json>
+Json decode_message(const char *data, std::size_t size, WireFormat format)
+{
+    switch (format) {
+    case WireFormat::Cbor:
+        return Json::from_cbor(data, data + size);
+    case WireFormat::MessagePack:
+        return Json::from_msgpack(data, data + size);
+    case WireFormat::Ubjson:
+        return Json::from_ubjson(data, data + size);
+    case WireFormat::Json:
+        break;
+    }
+    return Json::parse(data, data + size);
+}
+
+}
+
+#endif // WIRE_FORMAT_H
@@ -0,0 +1,104 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#include <webchannelpp/byte_search.h>
+#include <webchannelpp/receive_buffer.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test_util.h"
+
+using namespace WebChannelPP;
+
+// every implementation the CPU can run, checked against std::find
+static std::vector<detail::find_byte_fn> implementations()
+{
+    std::vector<detail::find_byte_fn> impls { detail::find_byte_scalar, find_byte };
+#ifdef WEBCHANNELPP_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        impls.push_back(detail::find_byte_sse2);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        impls.push_back(detail::find_byte_avx2);
+    }
+#endif
+    return impls;
+}
+
+static void test_positions()
+{
+    // needle at every position, at every alignment, for lengths around the vector widths
+    std::vector<char> data(256, 'x');
+    for (auto impl : implementations()) {
+        for (std::size_t offset = 0; offset < 32; ++offset) {
+            for (std::size_t size = 0; size <= 100; ++size) {
+                const char *first = data.data() + offset;
+                const char *last = first + size;
+                CHECK(impl(first, last, '\n') == last);
+
+                for (std::size_t pos = 0; pos < size; ++pos) {
+                    data[offset + pos] = '\n';
+                    CHECK(impl(first, last, '\n') == first + pos);
+                    data[offset + pos] = 'x';
+                }
+            }
+        }
+    }
+}
+
+static void test_random()
+{
+    std::mt19937 rng(42);
+    std::string data(64 * 1024, ' ');
+    for (char &c : data) {
+        c = char(rng() % 64 == 0 ? '\n' : 'a' + rng() % 26);
+    }
+    // bytes with the high bit set must not match by sign extension
+    data[100] = char(0x8a);
+
+    for (auto impl : implementations()) {
+        const char *first = data.data();
+        const char *last = first + data.size();
+        for (const char *pos = first; pos != last; ++pos) {
+            const char *expected = std::find(pos, last, '\n');
+            const char *found = impl(pos, last, '\n');
+            if (found != expected) {
+                CHECK(found == expected);
+                break;
+            }
+            pos = found == last ? last - 1 : found;
+        }
+        CHECK(impl(first, last, char(0x8a)) == first + 100);
+    }
+}
+
+static void test_resumed_scan()
+{
+    // a frame arriving in many reads is scanned once; the result must not change
+    ReceiveBuffer buffer;
+    const std::string frame(10000, 'y');
+    for (std::size_t pos = 0; pos < frame.size(); pos += 100) {
+        buffer.append(frame.data() + pos, 100);
+        FrameView view;
+        CHECK(!buffer.next_line(view));
+    }
+    buffer.append("\n", 1);
+    FrameView view;
+    REQUIRE(buffer.next_line(view));
+    CHECK(view.size == frame.size());
+}
+
+int main()
+{
+    test_positions();
+    test_random();
+    test_resumed_scan();
+    return Test::result();
+}
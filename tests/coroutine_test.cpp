@@ -0,0 +1,194 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Coroutines awaiting the channel, against the mock host over the loopback transport
+
+#include <webchannelpp/coroutine.h>
+#include <webchannelpp/loopback_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <set>
+
+#include "test_util.h"
+
+#ifndef WEBCHANNELPP_HAS_COROUTINES
+#error "coroutine_test must be built with C++20 coroutine support"
+#endif
+
+using namespace WebChannelPP;
+
+static MockHostConfig config()
+{
+    MockHostConfig cfg;
+    cfg.objects = 2;
+    return cfg;
+}
+
+static std::vector<nlohmann::json> arguments(int value)
+{
+    return std::vector<nlohmann::json> { value };
+}
+
+static Task<int> add(QObject *object, int a, int b)
+{
+    const auto first = co_await object->invoke_async("method0", arguments(a));
+    const auto second = co_await object->invoke_async("method0", arguments(b));
+    co_return first.value.get<int>() + second.value.get<int>();
+}
+
+struct RequestResults
+{
+    int step = 0;
+    int sum = 0;
+    ExecStatus unknown = ExecStatus::Ok;
+};
+
+// coroutine lambdas must not capture, their closure is gone once they suspend
+static Task<> requests(QWebChannel &channel, RequestResults &results)
+{
+    QWebChannel *ready = co_await channel_ready(channel);
+    CHECK(ready == &channel);
+    results.step = 1;
+
+    QObject *object = channel.object("object1");
+    // nested tasks
+    results.sum = co_await add(object, 20, 22);
+    results.step = 2;
+
+    const auto failed = co_await object->invoke_async("noSuchMethod", std::vector<nlohmann::json>());
+    CHECK(!failed);
+    results.unknown = failed.status;
+    results.step = 3;
+}
+
+static void test_requests()
+{
+    LoopbackPair pair;
+    MockHost host(pair.host, config());
+    QWebChannel channel(pair.client);
+
+    RequestResults results;
+    spawn(requests(channel, results));
+
+    CHECK(results.step == 0);
+    pair.run();
+    CHECK(results.step == 3);
+    CHECK(results.sum == 42);
+    CHECK(results.unknown == ExecStatus::Failed);
+    CHECK(host.stats().invokes == 2);
+}
+
+struct SignalResults
+{
+    std::vector<nlohmann::json> args;
+    nlohmann::json property;
+    ExecStatus missing = ExecStatus::Ok;
+    bool done = false;
+};
+
+static Task<> signals(QObject *object, SignalResults &results)
+{
+    const auto emitted = co_await next_signal(object, "signal1");
+    CHECK(emitted);
+    results.args = emitted.value;
+
+    const auto changed = co_await next_property_change(object, "property2");
+    CHECK(changed);
+    results.property = changed.value;
+
+    results.missing = (co_await next_signal(object, "noSuchSignal")).status;
+    results.done = true;
+}
+
+static void test_signals()
+{
+    LoopbackPair pair;
+    MockHost host(pair.host, config());
+    QWebChannel channel(pair.client);
+    pair.run();
+    QObject *object = channel.object("object0");
+    REQUIRE(object);
+
+    SignalResults results;
+    spawn(signals(object, results));
+    pair.run();
+    CHECK(results.args.empty());
+
+    host.emit_signal(0, 1, nlohmann::json::array({ "x", 2 }));
+    pair.run();
+    CHECK(results.args == std::vector<nlohmann::json>({ "x", 2 }));
+    CHECK(!results.done);
+
+    host.set_property(0, 2, 17);
+    pair.run();
+    CHECK(results.property == 17);
+    CHECK(results.missing == ExecStatus::Failed);
+    CHECK(results.done);
+
+    // the awaiter disconnected again
+    host.emit_signal(0, 1, nlohmann::json::array({ "y", 3 }));
+    pair.run();
+    CHECK(host.stats().signals_emitted == 1);
+}
+
+// Frames of finished coroutines are reused
+class CountingAllocator : public RecyclingFrameAllocator
+{
+public:
+    int allocations = 0;
+    int deallocations = 0;
+    std::set<void *> blocks;
+
+    void *allocate(std::size_t size) override
+    {
+        ++allocations;
+        void *ptr = RecyclingFrameAllocator::allocate(size);
+        blocks.insert(ptr);
+        return ptr;
+    }
+
+    void deallocate(void *ptr, std::size_t size) noexcept override
+    {
+        ++deallocations;
+        RecyclingFrameAllocator::deallocate(ptr, size);
+    }
+};
+
+static Task<int> identity(int value)
+{
+    co_return value;
+}
+
+static Task<> accumulate(int &sum, int value)
+{
+    sum += co_await identity(value);
+}
+
+static void test_frame_allocator()
+{
+    CountingAllocator allocator;
+    set_frame_allocator(&allocator);
+
+    int sum = 0;
+    for (int i = 0; i < 100; ++i) {
+        spawn(accumulate(sum, i));
+    }
+    set_frame_allocator(nullptr);
+
+    CHECK(sum == 4950);
+    // three frames per iteration: the detached runner, accumulate() and identity()
+    CHECK(allocator.allocations == 300);
+    CHECK(allocator.deallocations == 300);
+    CHECK(allocator.blocks.size() <= 3);
+}
+
+int main()
+{
+    test_requests();
+    test_signals();
+    test_frame_allocator();
+    return Test::result();
+}
@@ -0,0 +1,239 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/asio_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_util.h"
+
+using namespace WebChannelPP;
+
+static std::string str(const FrameView &frame)
+{
+    return std::string(frame.data, frame.size);
+}
+
+static void test_length_prefixed_policy()
+{
+    ReceiveBuffer buffer;
+    LengthPrefixedFraming::header_type header;
+    LengthPrefixedFraming::write_header(header, 0x01020304);
+    CHECK(header[0] == 1 && header[1] == 2 && header[2] == 3 && header[3] == 4);
+
+    // two frames, the second one split over several appends
+    const std::string payload = "with\nnewline";
+    LengthPrefixedFraming::write_header(header, payload.size());
+    for (int i = 0; i < 2; ++i) {
+        buffer.append(header.data(), header.size());
+        buffer.append(payload.data(), i == 0 ? payload.size() : 3);
+    }
+
+    FrameView frame;
+    CHECK(LengthPrefixedFraming::bytes_needed(buffer) == 0);
+    REQUIRE(LengthPrefixedFraming::next_frame(buffer, frame));
+    CHECK(str(frame) == payload);
+    CHECK(!LengthPrefixedFraming::next_frame(buffer, frame));
+    CHECK(LengthPrefixedFraming::bytes_needed(buffer) == payload.size() - 3);
+    CHECK(LengthPrefixedFraming::pending_frame_size(buffer) == payload.size());
+
+    buffer.append(payload.data() + 3, payload.size() - 3);
+    REQUIRE(LengthPrefixedFraming::next_frame(buffer, frame));
+    CHECK(str(frame) == payload);
+    CHECK(LengthPrefixedFraming::bytes_needed(buffer) == LengthPrefixedFraming::header_size);
+    CHECK(LengthPrefixedFraming::pending_frame_size(buffer) == 0);
+}
+
+template<class Transport>
+struct Connection
+{
+    asio::ip::tcp::socket clientSocket;
+    asio::ip::tcp::socket hostSocket;
+    std::unique_ptr<Transport> client;
+    std::unique_ptr<Transport> host;
+
+    explicit Connection(asio::io_context &io)
+        : clientSocket(io), hostSocket(io)
+    {
+        asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+        clientSocket.connect(acceptor.local_endpoint());
+        acceptor.accept(hostSocket);
+        client.reset(new Transport(clientSocket));
+        host.reset(new Transport(hostSocket));
+    }
+};
+
+template<class Transport>
+static void test_round_trip(const std::vector<nlohmann::json> &messages)
+{
+    asio::io_context io;
+    Connection<Transport> connection(io);
+
+    std::vector<nlohmann::json> received;
+    connection.host->register_message_handler([&](const nlohmann::json &message) { received.push_back(message); });
+
+    for (const auto &message : messages) {
+        connection.client->send(message);
+    }
+    while (received.size() < messages.size() && io.run_one_for(std::chrono::seconds(5)) > 0) {
+    }
+
+    CHECK(received == messages);
+}
+
+static void test_round_trips()
+{
+    std::vector<nlohmann::json> messages;
+    messages.push_back({ { "type", 6 }, { "id", 1 } });
+    messages.push_back({ { "text", "with\nnewline" } });
+    messages.push_back({ { "large", std::string(1024 * 1024, 'x') } });
+    for (int i = 0; i < 100; ++i) {
+        messages.push_back({ { "n", i } });
+    }
+
+    test_round_trip<AsioTransport>(messages);
+    test_round_trip<LengthPrefixedAsioTransport>(messages);
+}
+
+static void test_oversized_header()
+{
+    asio::io_context io;
+    Connection<LengthPrefixedAsioTransport> connection(io);
+    connection.client->set_max_frame_size(1024);
+
+    int received = 0;
+    connection.client->register_message_handler([&](const nlohmann::json &) { ++received; });
+
+    // a frame within the limit, then a header announcing almost 4 GiB
+    connection.host->send({ { "n", 1 } });
+    const char header[] = { '\xff', '\xff', '\xff', '\xf0' };
+    asio::write(connection.hostSocket, asio::buffer(header, sizeof(header)));
+
+    io.run_for(std::chrono::milliseconds(500));
+    CHECK(received == 1);
+    CHECK(!connection.clientSocket.is_open());
+}
+
+static void test_unterminated_line()
+{
+    asio::io_context io;
+    Connection<AsioTransport> connection(io);
+    connection.client->set_max_frame_size(64 * 1024);
+
+    const std::string garbage(128 * 1024, 'x');
+    asio::write(connection.hostSocket, asio::buffer(garbage));
+
+    io.run_for(std::chrono::milliseconds(500));
+    CHECK(!connection.clientSocket.is_open());
+}
+
+// Channels sharing an io_context that several threads run, each serialized by the strand of its transport
+static void test_shared_io_context()
+{
+    const int channels = 8;
+    const int invokes = 50;
+
+    asio::io_context io;
+    std::vector<std::unique_ptr<Connection<AsioTransport>>> connections;
+    std::vector<std::unique_ptr<MockHost>> hosts;
+    std::vector<std::unique_ptr<QWebChannel>> clients(channels);
+    std::vector<long> sums(channels, 0);
+    std::atomic<int> finished { 0 };
+    std::atomic<int> offStrand { 0 };
+
+    for (int c = 0; c < channels; ++c) {
+        connections.emplace_back(new Connection<AsioTransport>(io));
+        hosts.emplace_back(new MockHost(*connections[c]->host));
+    }
+
+    for (int c = 0; c < channels; ++c) {
+        AsioTransport &transport = *connections[c]->client;
+        transport.post([&, c]() {
+            clients[c].reset(new QWebChannel(transport, [&, c](QWebChannel *channel) {
+                QObject *object = channel->object("object0");
+                for (int i = 1; i <= invokes; ++i) {
+                    object->invoke("method0", i, [&, c, i](int result) {
+                        if (!transport.strand().running_in_this_thread()) {
+                            ++offStrand;
+                        }
+                        sums[c] += result;
+                        if (i == invokes) {
+                            ++finished;
+                        }
+                    });
+                }
+            }));
+        });
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&io]() { io.run_for(std::chrono::seconds(10)); });
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (finished < channels && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    io.stop();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    CHECK(finished == channels);
+    CHECK(offStrand == 0);
+    for (int c = 0; c < channels; ++c) {
+        CHECK(sums[c] == invokes * (invokes + 1) / 2);
+        CHECK(hosts[c]->stats().invokes == std::size_t(invokes));
+    }
+}
+
+// A write that fails drops the queue, so neither memory nor backpressure is held forever
+static void test_failed_write()
+{
+    asio::io_context io;
+    Connection<AsioTransport> connection(io);
+    AsioTransport &transport = *connection.client;
+    transport.set_high_water_mark(4096);
+
+    std::vector<bool> backpressure;
+    transport.register_backpressure_handler([&](bool enabled) { backpressure.push_back(enabled); });
+
+    for (int i = 0; i < 10; ++i) {
+        transport.send({ { "payload", std::string(1000, 'x') } });
+    }
+    CHECK(transport.backpressure());
+    CHECK(transport.queued_bytes() > 4096);
+
+    connection.clientSocket.close();
+    io.run_for(std::chrono::milliseconds(200));
+
+    CHECK(transport.failed());
+    CHECK(transport.queued_bytes() == 0);
+    CHECK(!transport.backpressure());
+    CHECK(backpressure == std::vector<bool>({ true, false }));
+    CHECK(transport.buffer_pool().size() >= 9);
+
+    // later messages are dropped right away
+    transport.send({ { "n", 1 } });
+    CHECK(transport.queued_bytes() == 0);
+}
+
+int main()
+{
+    test_length_prefixed_policy();
+    test_round_trips();
+    test_oversized_header();
+    test_unterminated_line();
+    test_shared_io_context();
+    test_failed_write();
+    return Test::result();
+}
@@ -0,0 +1,78 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/asio_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "test_util.h"
+
+using namespace WebChannelPP;
+
+#ifdef ASIO_HAS_LOCAL_SOCKETS
+
+template<class Transport>
+static void test_channel(const asio::local::stream_protocol::endpoint &endpoint)
+{
+    asio::io_context io;
+    asio::local::stream_protocol::acceptor acceptor(io, endpoint);
+    asio::local::stream_protocol::socket clientSocket(io);
+    asio::local::stream_protocol::socket hostSocket(io);
+    clientSocket.connect(endpoint);
+    acceptor.accept(hostSocket);
+
+    Transport hostTransport(hostSocket);
+    Transport clientTransport(clientSocket);
+
+    MockHostConfig config;
+    config.objects = 3;
+    MockHost host(hostTransport, config);
+
+    bool initialized = false;
+    std::string result;
+    QWebChannel channel(clientTransport, [&](QWebChannel *channel) {
+        initialized = true;
+        channel->object("object2")->invoke("method1", std::string(100000, 'z'), [&](const std::string &r) { result = r; });
+    });
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (result.empty() && std::chrono::steady_clock::now() < deadline) {
+        io.run_one_for(std::chrono::milliseconds(100));
+    }
+
+    CHECK(initialized);
+    CHECK(channel.objects().size() == 3);
+    CHECK(result == std::string(100000, 'z'));
+    CHECK(host.stats().invokes == 1);
+}
+
+int main()
+{
+    // abstract namespace: no file to clean up
+    const std::string name = "webchannelpp-test-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    test_channel<LocalAsioTransport>(abstract_endpoint(name));
+    test_channel<LengthPrefixedLocalAsioTransport>(abstract_endpoint(name + "-length-prefixed"));
+
+    // socket file
+    const std::string path = "/tmp/" + name + ".sock";
+    test_channel<LocalAsioTransport>(asio::local::stream_protocol::endpoint(path));
+    std::remove(path.c_str());
+
+    return Test::result();
+}
+
+#else
+
+int main()
+{
+    return Test::skipped;
+}
+
+#endif
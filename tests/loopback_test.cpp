@@ -0,0 +1,1008 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Client stack against the mock host, over the loopback transport
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/loopback_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "test_util.h"
+
+using namespace WebChannelPP;
+
+static MockHostConfig config()
+{
+    MockHostConfig cfg;
+    cfg.objects = 3;
+    cfg.methods = 3;
+    cfg.properties = 3;
+    cfg.signals = 2;
+    return cfg;
+}
+
+static void test_init(bool serialize)
+{
+    LoopbackPair pair;
+    pair.client.set_serialize(serialize);
+    pair.host.set_serialize(serialize);
+    MockHost host(pair.host, config());
+
+    bool ready = false;
+    QWebChannel channel(pair.client, [&](QWebChannel *) { ready = true; });
+    CHECK(!ready);
+    pair.run();
+
+    REQUIRE(ready);
+    CHECK(channel.objects().size() == 3);
+    QObject *object = channel.object("object2");
+    REQUIRE(object);
+    CHECK(object->methods().count("method2") == 1);
+    CHECK(object->properties().count("property1") == 1);
+    CHECK(object->signalNames().count("signal1") == 1);
+    CHECK(int(object->property("property0")) == 0);
+    CHECK(channel.object("object3") == nullptr);
+}
+
+static void test_invoke(bool serialize)
+{
+    LoopbackPair pair;
+    pair.client.set_serialize(serialize);
+    pair.host.set_serialize(serialize);
+    MockHost host(pair.host, config());
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+
+    QObject *object = channel.object("object1");
+    REQUIRE(object);
+
+    int result = -1;
+    CHECK(object->invoke("method2", 42, [&](int r) { result = r; }));
+    CHECK(result == -1);
+    pair.run();
+    CHECK(result == 42);
+    CHECK(host.stats().invokes == 1);
+
+    host.set_method_handler([](const std::string &name, int method, const nlohmann::json &args) {
+        return nlohmann::json(name + ":" + std::to_string(method) + ":" + args.dump());
+    });
+    std::string text;
+    object->invoke("method0", std::vector<nlohmann::json> { "a", 1 },
+                   std::function<void(const nlohmann::json &)>([&](const nlohmann::json &r) { text = r; }));
+    pair.run();
+    CHECK(text == "object1:0:[\"a\",1]");
+
+    CHECK(!object->invoke("noSuchMethod", 1));
+}
+
+static void test_signals()
+{
+    LoopbackPair pair;
+    MockHost host(pair.host, config());
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+
+    QObject *object = channel.object("object0");
+    REQUIRE(object);
+
+    int sum = 0;
+    const unsigned int id = object->connect("signal1", [&](int value) { sum += value; });
+    CHECK(id != 0);
+    pair.run();
+
+    host.emit_signal(0, 1, nlohmann::json::array({ 5 }));
+    pair.run();
+    CHECK(sum == 5);
+
+    // signals of other objects are not delivered here
+    host.emit_signal(1, 1, nlohmann::json::array({ 7 }));
+    pair.run();
+    CHECK(sum == 5);
+
+    CHECK(object->disconnect(id));
+    pair.run();
+    host.emit_signal(0, 1, nlohmann::json::array({ 9 }));
+    pair.run();
+    CHECK(sum == 5);
+    // the host only emits signals the client is connected to
+    CHECK(host.stats().signals_emitted == 1);
+
+    CHECK(object->connect("noSuchSignal", [](int) {}) == 0);
+}
+
+static void test_properties(bool serialize)
+{
+    LoopbackPair pair;
+    pair.client.set_serialize(serialize);
+    pair.host.set_serialize(serialize);
+    MockHost host(pair.host, config());
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+
+    QObject *object = channel.object("object1");
+    REQUIRE(object);
+
+    int changes = 0;
+    object->connect("property2Changed", [&](int) { ++changes; });
+    pair.run();
+
+    object->set_property("property2", 7);
+    pair.run();
+    CHECK(host.property(1, 2) == 7);
+    CHECK(int(object->property("property2")) == 7);
+    CHECK(changes == 1);
+
+    // updates from the host arrive once the client is idle again
+    host.set_property(1, 2, 11);
+    pair.run();
+    CHECK(int(object->property("property2")) == 11);
+    CHECK(changes == 2);
+    CHECK(host.stats().idles >= 2);
+}
+
+static void test_tick()
+{
+    LoopbackPair pair;
+    MockHost host(pair.host, config());
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+
+    int signals = 0;
+    for (const auto &entry : channel.objects()) {
+        entry.second->connect("signal0", [&](int) { ++signals; });
+        entry.second->connect("signal1", [&](int) { ++signals; });
+    }
+    pair.run();
+
+    host.set_signal_rate(6);
+    host.set_property_update_rate(9);
+    for (int i = 0; i < 10; ++i) {
+        host.tick();
+        pair.run();
+    }
+
+    CHECK(signals == 60);
+    CHECK(host.stats().signals_emitted == 60);
+    CHECK(host.stats().property_updates_sent > 0);
+}
+
+// The writer produces the same text as serializing the message object
+static void test_writer()
+{
+    MessageWriter writer;
+    const std::vector<nlohmann::json> args { 1, "two \"quoted\"\n", 2.5, nullptr, { { "key", { 1, 2 } } } };
+    const std::string object = "object\t\x01\xc3\xa4";
+
+    std::string out;
+    writer.write_invoke(out, object, 7, args, 42);
+    CHECK(out == nlohmann::json({
+        { "type", BasicQWebChannelMessageTypes::InvokeMethod },
+        { "method", 7 },
+        { "args", args },
+        { "object", object },
+        { "id", 42 },
+    }).dump());
+
+    out.clear();
+    writer.write_invoke(out, object, -1, {}, 0);
+    CHECK(out == nlohmann::json({
+        { "type", BasicQWebChannelMessageTypes::InvokeMethod },
+        { "method", -1 },
+        { "args", nlohmann::json::array() },
+        { "object", object },
+        { "id", 0 },
+    }).dump());
+
+    out.clear();
+    writer.write_set_property(out, object, 3, args[4]);
+    CHECK(out == nlohmann::json({
+        { "type", BasicQWebChannelMessageTypes::SetProperty },
+        { "property", 3 },
+        { "value", args[4] },
+        { "object", object },
+    }).dump());
+
+    out.clear();
+    writer.write_signal_connection(out, BasicQWebChannelMessageTypes::ConnectToSignal, object, 5);
+    CHECK(out == nlohmann::json({
+        { "type", BasicQWebChannelMessageTypes::ConnectToSignal },
+        { "object", object },
+        { "signal", 5 },
+    }).dump());
+
+    out.clear();
+    writer.write_message(out, BasicQWebChannelMessageTypes::Idle);
+    CHECK(out == nlohmann::json({ { "type", BasicQWebChannelMessageTypes::Idle } }).dump());
+
+    out.clear();
+    writer.write_message(out, BasicQWebChannelMessageTypes::Init, 4294967295u);
+    CHECK(out == nlohmann::json({ { "type", BasicQWebChannelMessageTypes::Init }, { "id", 4294967295u } }).dump());
+
+    out.clear();
+    MessageWriter::write_integer(out, -9223372036854775807LL - 1);
+    CHECK(out == "-9223372036854775808");
+}
+
+static bool decode(BasicMessageDecoder<nlohmann::json> &decoder, const nlohmann::json &message)
+{
+    const std::string text = message.dump();
+    return decoder.decode(text.data(), text.size());
+}
+
+static void test_decoder()
+{
+    BasicMessageDecoder<nlohmann::json> decoder;
+    decoder.set_object_filter([](const std::string &object) { return object != "ignored"; });
+    auto &message = decoder.message();
+
+    const nlohmann::json args = { 1, "two", { { "three", { 3, nullptr } } }, nlohmann::json::array() };
+    REQUIRE(decode(decoder, { { "type", BasicQWebChannelMessageTypes::QSignal }, { "object", "object1" },
+                              { "signal", 5 }, { "args", args } }));
+    CHECK(message.complete);
+    CHECK(message.type == BasicQWebChannelMessageTypes::QSignal);
+    CHECK(message.object == "object1");
+    CHECK(message.signal == 5);
+    CHECK(message.hasArgs && message.args == args);
+
+    REQUIRE(decode(decoder, { { "type", BasicQWebChannelMessageTypes::Response }, { "id", 4000000000u },
+                              { "data", { { "result", args } } } }));
+    CHECK(message.complete);
+    CHECK(message.id == 4000000000u);
+    CHECK(message.data == nlohmann::json({ { "result", args } }));
+
+    // the values of objects rejected by the filter are not decoded
+    const nlohmann::json properties = { { "0", 1 }, { "1", { { "nested", true } } } };
+    const nlohmann::json signals = { { "4", { 1 } } };
+    REQUIRE(decode(decoder, { { "type", BasicQWebChannelMessageTypes::PropertyUpdate }, { "data", {
+        { { "object", "object0" }, { "signals", signals }, { "properties", properties } },
+        { { "object", "ignored" }, { "signals", signals }, { "properties", properties } },
+    } } }));
+    CHECK(message.complete);
+    REQUIRE(message.updates.size() == 2);
+    CHECK(message.updates[0].object == "object0");
+    CHECK(!message.updates[0].skipped);
+    CHECK(message.updates[0].signals == signals);
+    CHECK(message.updates[0].properties == properties);
+    CHECK(message.updates[1].skipped);
+    CHECK(message.updates[1].properties.is_null());
+
+    // a response with an array as data is decoded as property updates first, and must be parsed again
+    REQUIRE(decode(decoder, { { "type", BasicQWebChannelMessageTypes::Response }, { "id", 1 },
+                              { "data", { 1, 2 } } }));
+    CHECK(!message.complete);
+    // so are messages lacking fields
+    REQUIRE(decode(decoder, { { "type", BasicQWebChannelMessageTypes::QSignal }, { "signal", 1 } }));
+    CHECK(!message.complete);
+
+    const std::string broken = "{\"type\":1,";
+    CHECK(!decoder.decode(broken.data(), broken.size()));
+}
+
+// The channel decodes messages that arrive as text itself
+static void test_decoded_dispatch()
+{
+    LoopbackPair pair;
+    pair.client.set_serialize(true);
+    pair.host.set_serialize(true);
+    MockHost host(pair.host, config());
+    host.set_method_handler([](const std::string &, int, const nlohmann::json &args) { return args; });
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+
+    QObject *object = channel.object("object2");
+    REQUIRE(object);
+
+    // a response with an array as data takes the fallback
+    nlohmann::json result;
+    object->invoke("method1", std::vector<nlohmann::json> { 1, "two" },
+                   std::function<void(const nlohmann::json &)>([&](const nlohmann::json &r) { result = r; }));
+    pair.run();
+    CHECK(result == nlohmann::json({ 1, "two" }));
+
+    std::vector<nlohmann::json> received;
+    object->connect("signal0", std::function<void(const std::vector<nlohmann::json> &)>(
+                        [&](const std::vector<nlohmann::json> &args) { received = args; }));
+    pair.run();
+    host.emit_signal(2, 0, nlohmann::json::array({ "a", { { "b", 1 } } }));
+    pair.run();
+    CHECK(received == std::vector<nlohmann::json>({ "a", { { "b", 1 } } }));
+}
+
+static void test_callback_table()
+{
+    CallbackTable<int> table(4);
+    const unsigned int a = table.insert(1);
+    const unsigned int b = table.insert(2);
+    CHECK(a != b);
+    CHECK(table.size() == 2);
+
+    int value = 0;
+    CHECK(table.take(b, value) && value == 2);
+    CHECK(!table.take(b, value));
+    CHECK(!table.contains(b));
+
+    // ids keep increasing while a long-running request holds its slot, and the table grows
+    std::vector<unsigned int> ids;
+    for (int i = 0; i < 1000; ++i) {
+        ids.push_back(table.insert(100 + i));
+        CHECK(ids.back() != a);
+    }
+    CHECK(table.size() == 1001);
+    CHECK(table.capacity() >= 2002);
+    for (int i = 0; i < 1000; ++i) {
+        CHECK(table.take(ids[i], value) && value == 100 + i);
+    }
+    CHECK(table.contains(a));
+    CHECK(table.take(a, value) && value == 1);
+    CHECK(table.empty());
+
+    // an id that maps to a reused slot is stale
+    const unsigned int c = table.insert(3);
+    CHECK(!table.take(c + unsigned(table.capacity()), value));
+    CHECK(table.take(c, value) && value == 3);
+}
+
+static void test_many_requests()
+{
+    LoopbackPair pair;
+    MockHost host(pair.host, config());
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+    QObject *object = channel.object("object0");
+    REQUIRE(object);
+
+    const int count = 10000;
+    std::vector<int> results(count, -1);
+    for (int i = 0; i < count; ++i) {
+        object->invoke("method0", i, [&results, i](int r) { results[i] = r; });
+    }
+    CHECK(channel.pending_requests() == std::size_t(count));
+    pair.run();
+    CHECK(channel.pending_requests() == 0);
+    int correct = 0;
+    for (int i = 0; i < count; ++i) {
+        correct += results[i] == i;
+    }
+    CHECK(correct == count);
+
+    // responses to unknown requests are dropped
+    pair.host.send(nlohmann::json {
+        { "type", BasicQWebChannelMessageTypes::Response },
+        { "id", 123456789 },
+        { "data", 1 },
+    });
+    pair.run();
+    CHECK(channel.pending_requests() == 0);
+}
+
+static void test_timer_wheel()
+{
+    typedef TimerWheel<int>::clock clock;
+    const clock::time_point start = clock::now();
+    TimerWheel<int> wheel(std::chrono::milliseconds(10), 8, start);
+
+    std::vector<int> expired;
+    auto collect = [&](int key) { expired.push_back(key); };
+    wheel.schedule(1, start + std::chrono::milliseconds(25));
+    wheel.schedule(2, start + std::chrono::milliseconds(5));
+    // beyond a full revolution of the wheel
+    wheel.schedule(3, start + std::chrono::milliseconds(500));
+    CHECK(wheel.size() == 3);
+
+    CHECK(wheel.advance(start + std::chrono::milliseconds(9), collect) == 0);
+    CHECK(wheel.advance(start + std::chrono::milliseconds(10), collect) == 1);
+    CHECK(expired == std::vector<int>({ 2 }));
+    // never early, deadlines are rounded up to the next tick
+    CHECK(wheel.advance(start + std::chrono::milliseconds(29), collect) == 0);
+    CHECK(wheel.advance(start + std::chrono::milliseconds(30), collect) == 1);
+    CHECK(wheel.advance(start + std::chrono::milliseconds(499), collect) == 0);
+    CHECK(wheel.advance(start + std::chrono::seconds(1), collect) == 1);
+    CHECK(expired == std::vector<int>({ 2, 1, 3 }));
+    CHECK(wheel.empty());
+}
+
+static void test_timeouts()
+{
+    LoopbackPair pair;
+    MockHost host(pair.host, config());
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+    QObject *object = channel.object("object0");
+    REQUIRE(object);
+
+    std::vector<ExecStatus> statuses;
+    auto record = [&](ExecStatus status, const nlohmann::json &) { statuses.push_back(status); };
+
+    // answered in time
+    CHECK(object->invoke_with_timeout("method0", { 1 }, record, std::chrono::milliseconds(1000)));
+    pair.run();
+    CHECK(statuses == std::vector<ExecStatus>({ ExecStatus::Ok }));
+
+    // the host does not get to answer before the deadline
+    statuses.clear();
+    CHECK(object->invoke_with_timeout("method0", { 2 }, record, std::chrono::milliseconds(20)));
+    CHECK(object->invoke_with_timeout("method0", { 3 }, record, std::chrono::milliseconds(0)));
+    CHECK(channel.process_timeouts() == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(channel.process_timeouts() == 1);
+    CHECK(statuses == std::vector<ExecStatus>({ ExecStatus::Timeout }));
+    CHECK(channel.pending_requests() == 1);
+
+    // the late answer is dropped, the one without a timeout still arrives
+    pair.run();
+    CHECK(statuses == std::vector<ExecStatus>({ ExecStatus::Timeout, ExecStatus::Ok }));
+    CHECK(channel.pending_requests() == 0);
+
+    // plain callbacks use the default timeout and are dropped when it expires
+    channel.set_default_timeout(std::chrono::milliseconds(20));
+    int plain = 0;
+    CHECK(object->invoke("method0", 4, [&](int) { ++plain; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // timeouts are also processed for every incoming message
+    pair.run();
+    CHECK(plain == 0);
+    CHECK(channel.pending_requests() == 0);
+}
+
+static void test_futures()
+{
+    LoopbackPair pair;
+    MockHost host(pair.host, config());
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+    QObject *object = channel.object("object0");
+    REQUIRE(object);
+
+    Future<nlohmann::json> future = object->invoke_async("method0", { 5 });
+    CHECK(future.valid());
+    CHECK(!future.is_ready());
+    int continued = 0;
+    future.then([&](ExecStatus status, const nlohmann::json &value) {
+        CHECK(status == ExecStatus::Ok);
+        CHECK(value == 5);
+        ++continued;
+    });
+    pair.run();
+    REQUIRE(future.is_ready());
+    CHECK(future.status() == ExecStatus::Ok);
+    CHECK(future.value() == 5);
+    CHECK(continued == 1);
+
+    // continuations added later run right away
+    future.then([&](ExecStatus, const nlohmann::json &) { ++continued; });
+    CHECK(continued == 2);
+
+    Future<nlohmann::json> failed = object->invoke_async("noSuchMethod", {});
+    CHECK(failed.is_ready() && failed.status() == ExecStatus::Failed);
+
+    Future<nlohmann::json> timedOut = object->invoke_async("method0", { 1 }, std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    channel.process_timeouts();
+    CHECK(timedOut.is_ready() && timedOut.status() == ExecStatus::Timeout);
+    pair.run();
+
+    std::vector<Future<nlohmann::json>> futures;
+    for (int i = 0; i < 10; ++i) {
+        futures.push_back(object->invoke_async("method0", { i }));
+    }
+    Future<std::vector<nlohmann::json>> all = when_all(futures);
+    CHECK(!all.is_ready());
+    pair.run();
+    REQUIRE(all.is_ready());
+    CHECK(all.status() == ExecStatus::Ok);
+    REQUIRE(all.value().size() == 10);
+    for (int i = 0; i < 10; ++i) {
+        CHECK(all.value()[i] == i);
+    }
+
+    // fails with the first failure
+    Future<std::vector<nlohmann::json>> mixed = when_all(std::vector<Future<nlohmann::json>> {
+        object->invoke_async("method0", { 1 }), failed,
+    });
+    pair.run();
+    CHECK(mixed.is_ready() && mixed.status() == ExecStatus::Failed);
+
+    Future<std::vector<nlohmann::json>> none = when_all(std::vector<Future<nlohmann::json>>());
+    CHECK(none.is_ready() && none.status() == ExecStatus::Ok && none.value().empty());
+}
+
+// A future may be awaited by several consumers
+static void test_future_continuations()
+{
+    Promise<int> promise;
+    Future<int> future = promise.get_future();
+
+    std::vector<int> order;
+    future.then([&](ExecStatus, int value) { order.push_back(value); });
+    Future<std::vector<int>> twice = when_all(std::vector<Future<int>> { future, future });
+    future.then([&](ExecStatus, int value) { order.push_back(-value); });
+    CHECK(!twice.is_ready());
+
+    promise.set_value(3);
+    CHECK(order == std::vector<int>({ 3, -3 }));
+    REQUIRE(twice.is_ready());
+    CHECK(twice.value() == std::vector<int>({ 3, 3 }));
+
+    // completing again has no effect
+    promise.set_value(4);
+    CHECK(future.value() == 3);
+    CHECK(order.size() == 2);
+}
+
+static void test_mpsc_queue()
+{
+    MpscQueue<int> queue;
+    int value = 0;
+    CHECK(queue.empty());
+    CHECK(!queue.pop(value));
+
+    const int producers = 4;
+    const int perProducer = 10000;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 0; i < perProducer; ++i) {
+                queue.push(p * perProducer + i);
+            }
+        });
+    }
+
+    // values of each producer arrive in the order they were pushed
+    std::vector<int> last(producers, -1);
+    int popped = 0;
+    bool ordered = true;
+    while (popped < producers * perProducer) {
+        if (!queue.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        const int producer = value / perProducer;
+        ordered = ordered && value % perProducer > last[producer];
+        last[producer] = value % perProducer;
+        ++popped;
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    CHECK(ordered);
+    CHECK(queue.empty());
+}
+
+static void test_submissions()
+{
+    LoopbackPair pair;
+    MockHost host(pair.host, config());
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    std::atomic<int> notified { 0 };
+    channel.set_submission_notifier([&]() { ++notified; });
+    pair.run();
+    QObject *object = channel.object("object1");
+    REQUIRE(object);
+
+    const std::thread::id channelThread = std::this_thread::get_id();
+    const int producers = 4;
+    const int perProducer = 250;
+    std::mutex mutex;
+    std::vector<std::function<void()>> completions;
+    std::atomic<long> sum { 0 };
+    std::atomic<int> failed { 0 };
+    std::atomic<int> done { 0 };
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            // completions are handed back through the executor
+            Executor executor = [&](std::function<void()> completion) {
+                std::lock_guard<std::mutex> lock(mutex);
+                completions.push_back(std::move(completion));
+            };
+            for (int i = 0; i < perProducer; ++i) {
+                object->post_invoke("method0", { p * perProducer + i }, [&](ExecStatus status, const nlohmann::json &r) {
+                    if (status == ExecStatus::Ok) {
+                        sum += r.get<long>();
+                    }
+                    ++done;
+                }, executor);
+            }
+            object->post_invoke("noSuchMethod", {}, [&](ExecStatus status, const nlohmann::json &) {
+                CHECK(std::this_thread::get_id() == channelThread);
+                failed += status == ExecStatus::Failed;
+            });
+            object->post_set_property("property0", p);
+        });
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (done < producers * perProducer && std::chrono::steady_clock::now() < deadline) {
+        channel.process_submissions();
+        pair.run();
+
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.swap(completions);
+        }
+        for (const auto &completion : ready) {
+            completion();
+        }
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    channel.process_submissions();
+    pair.run();
+
+    const long count = producers * perProducer;
+    CHECK(done == count);
+    CHECK(sum == count * (count - 1) / 2);
+    CHECK(failed == producers);
+    CHECK(host.stats().invokes == std::size_t(count));
+    CHECK(host.stats().property_sets == std::size_t(producers));
+    CHECK(notified >= 1);
+    CHECK(channel.process_submissions() == 0);
+}
+
+static void test_registry()
+{
+    ObjectRegistry<int> registry(4);
+    typedef ObjectRegistry<int>::Handle Handle;
+
+    std::vector<Handle> handles;
+    for (int i = 0; i < 100; ++i) {
+        const std::string name = "object" + std::to_string(i);
+        handles.push_back(registry.intern(name));
+        registry.set_value(handles.back(), i + 1);
+    }
+    CHECK(registry.size() == 100);
+    for (int i = 0; i < 100; ++i) {
+        const std::string name = "object" + std::to_string(i);
+        CHECK(registry.intern(name) == handles[i]);
+        CHECK(registry.find(name.data(), name.size()) == handles[i]);
+        CHECK(registry.get(name) == i + 1);
+        CHECK(registry.name(handles[i]) == name);
+    }
+    CHECK(registry.find("object100") == ObjectRegistry<int>::npos);
+    CHECK(registry.get("object100") == 0);
+
+    // removed names are gone, the others are still found past their tombstones
+    for (int i = 0; i < 100; i += 2) {
+        registry.remove(handles[i]);
+    }
+    CHECK(registry.size() == 50);
+    for (int i = 0; i < 100; ++i) {
+        const std::string name = "object" + std::to_string(i);
+        CHECK((registry.find(name) == ObjectRegistry<int>::npos) == (i % 2 == 0));
+    }
+    CHECK(registry.get("object1") == 2);
+
+    // a new name reuses a freed handle and starts without a value
+    const Handle reused = registry.intern("new");
+    CHECK(reused < 100);
+    CHECK(registry.value(reused) == 0);
+    CHECK(registry.name(reused) == "new");
+
+    // names that come and go don't make the registry grow
+    const std::size_t handlesBefore = registry.handles();
+    for (int i = 0; i < 100000; ++i) {
+        registry.remove(registry.intern("transient" + std::to_string(i)));
+    }
+    CHECK(registry.handles() == handlesBefore);
+    CHECK(registry.size() == 51);
+    CHECK(registry.get("object99") == 100);
+}
+
+// Metadata of an object the host creates at run time, with the destroyed() signal at index 0
+static nlohmann::json dynamic_object(const std::string &id)
+{
+    return nlohmann::json {
+        { "__QObject*__", true },
+        { "id", id },
+        { "data", {
+            { "methods", nlohmann::json::array() },
+            { "properties", nlohmann::json::array() },
+            { "signals", nlohmann::json::array({ nlohmann::json::array({ "destroyed", 0 }), nlohmann::json::array({ "signal1", 1 }) }) },
+        } },
+    };
+}
+
+static bool alive(QObject *object)
+{
+    // from_json only returns pointers to objects that were not deleted
+    const nlohmann::json ptr = object;
+    return ptr.get<QObject *>() != nullptr;
+}
+
+static void test_dispatcher(SignalOrder order)
+{
+    LoopbackPair pair;
+    MockHost host(pair.host, config());
+    host.set_method_handler([](const std::string &, int, const nlohmann::json &) {
+        return dynamic_object("dynamic");
+    });
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    SignalDispatcher dispatcher(4);
+    channel.set_signal_dispatcher(&dispatcher, order);
+    pair.run();
+
+    QObject *object = channel.object("object0");
+    REQUIRE(object);
+
+    const std::thread::id channelThread = std::this_thread::get_id();
+    std::mutex mutex;
+    std::vector<int> received;
+    std::atomic<int> offThread { 0 };
+    object->connect("signal0", [&](int value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.push_back(value);
+        if (std::this_thread::get_id() != channelThread) {
+            ++offThread;
+        }
+    });
+    int direct = 0;
+    object->connect_direct("signal0", [&](const std::vector<nlohmann::json> &) {
+        CHECK(std::this_thread::get_id() == channelThread);
+        ++direct;
+    });
+    pair.run();
+
+    for (int i = 0; i < 100; ++i) {
+        host.emit_signal(0, 0, nlohmann::json::array({ i }));
+    }
+    pair.run();
+    dispatcher.wait_idle();
+
+    CHECK(direct == 100);
+    CHECK(offThread == 100);
+    REQUIRE(received.size() == 100);
+    for (int i = 0; i < 100; ++i) {
+        CHECK(received[i] == i);
+    }
+
+    // an object created at run time is deleted once the callbacks of its destroyed() signal ran
+    QObject *dynamic = nullptr;
+    object->invoke("method0", [&](QObject *result) { dynamic = result; });
+    pair.run();
+    REQUIRE(dynamic);
+    REQUIRE(channel.object("dynamic") == dynamic);
+
+    std::atomic<bool> release { false };
+    std::atomic<int> destroyedCalls { 0 };
+    dynamic->connect("destroyed", [&]() {
+        // still alive while its callbacks run, even when they are slow
+        while (!release) {
+            std::this_thread::yield();
+        }
+        CHECK(alive(dynamic));
+        ++destroyedCalls;
+    });
+    pair.run();
+
+    pair.host.send(nlohmann::json {
+        { "type", BasicQWebChannelMessageTypes::QSignal },
+        { "object", "dynamic" },
+        { "signal", 0 },
+        { "args", nlohmann::json::array() },
+    });
+    pair.run();
+
+    // unregistered right away, on the thread of the channel
+    CHECK(channel.object("dynamic") == nullptr);
+    CHECK(alive(dynamic));
+    release = true;
+    dispatcher.wait_idle();
+    CHECK(destroyedCalls == 1);
+    CHECK(!alive(dynamic));
+}
+
+// Objects created at run time leave the channel when they are destroyed, and may come back
+static void test_dynamic_objects()
+{
+    LoopbackPair pair;
+    MockHost host(pair.host, config());
+    host.set_method_handler([](const std::string &, int, const nlohmann::json &args) {
+        return dynamic_object(args[0].get<std::string>());
+    });
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    pair.run();
+    QObject *object = channel.object("object0");
+    REQUIRE(object);
+
+    for (int round = 0; round < 3; ++round) {
+        for (const char *name : { "first", "second" }) {
+            QObject *dynamic = nullptr;
+            object->invoke("method0", name, [&](QObject *result) { dynamic = result; });
+            pair.run();
+            REQUIRE(dynamic);
+            CHECK(channel.object(name) == dynamic);
+            CHECK(dynamic->id() == name);
+        }
+
+        int signals = 0;
+        channel.object("second")->connect("signal1", [&]() { ++signals; });
+        pair.run();
+
+        pair.host.send(nlohmann::json {
+            { "type", BasicQWebChannelMessageTypes::QSignal },
+            { "object", "first" },
+            { "signal", 0 },
+        });
+        pair.host.send(nlohmann::json {
+            { "type", BasicQWebChannelMessageTypes::QSignal },
+            { "object", "second" },
+            { "signal", 1 },
+        });
+        pair.run();
+        CHECK(channel.object("first") == nullptr);
+        CHECK(signals == 1);
+
+        pair.host.send(nlohmann::json {
+            { "type", BasicQWebChannelMessageTypes::QSignal },
+            { "object", "second" },
+            { "signal", 0 },
+        });
+        pair.run();
+        CHECK(channel.object("second") == nullptr);
+        CHECK(channel.objects().size() == 3);
+    }
+}
+
+static void test_lazy_objects(bool serialize)
+{
+    LoopbackPair pair;
+    pair.client.set_serialize(serialize);
+    pair.host.set_serialize(serialize);
+    MockHost host(pair.host, config());
+    // a property referring to another object
+    host.set_property(0, 1, nlohmann::json { { "__QObject*__", true }, { "id", "object2" } });
+    QWebChannel channel(pair.client, [](QWebChannel *) {});
+    channel.set_lazy_objects(true);
+    CHECK(channel.lazy_objects());
+    pair.run();
+    REQUIRE(channel.initialized());
+
+    // the first use builds an object, and the ones it refers to
+    QObject *object0 = channel.object("object0");
+    REQUIRE(object0);
+    CHECK(channel.object("object0") == object0);
+    CHECK(object0->methods().count("method2") == 1);
+    QObject *referenced = object0->property("property1");
+    CHECK(referenced == channel.object("object2"));
+    CHECK(channel.object("object3") == nullptr);
+
+    int sum = 0;
+    object0->connect("signal0", [&](int value) { sum += value; });
+    pair.run();
+    host.emit_signal(0, 0, nlohmann::json::array({ 3 }));
+    pair.run();
+    CHECK(sum == 3);
+
+    // an update for an object that was not built yet builds it
+    host.set_property(1, 0, 5);
+    pair.run();
+    CHECK(int(channel.object("object1")->property("property0")) == 5);
+
+    CHECK(channel.objects().size() == 3);
+    for (const auto &entry : channel.objects()) {
+        CHECK(channel.object(entry.first) == entry.second);
+    }
+}
+
+// The objects of a channel, in a form that can be compared between channels
+static std::vector<nlohmann::json> describe(QWebChannel &channel)
+{
+    std::vector<nlohmann::json> objects;
+    for (const auto &entry : channel.objects()) {
+        QObject *object = entry.second;
+        nlohmann::json properties;
+        for (const auto &name : object->properties()) {
+            const nlohmann::json &value = object->property(name).json();
+            if (value.is_object()) {
+                QObject *referenced = object->property(name);
+                properties[name] = referenced ? referenced->id() : "";
+            } else {
+                properties[name] = value;
+            }
+        }
+        objects.push_back(nlohmann::json {
+            { "id", object->id() },
+            { "methods", object->methods() },
+            { "signals", object->signalNames() },
+            { "properties", properties },
+        });
+    }
+    return objects;
+}
+
+static void test_parallel_init(bool serialize)
+{
+    MockHostConfig cfg = config();
+    cfg.objects = 300;
+
+    std::vector<nlohmann::json> expected;
+    for (std::size_t threads : { 1, 4, 16 }) {
+        LoopbackPair pair;
+        pair.client.set_serialize(serialize);
+        pair.host.set_serialize(serialize);
+        MockHost host(pair.host, cfg);
+        // properties referring to objects built by other threads, and to the object itself
+        host.set_property(0, 0, nlohmann::json { { "__QObject*__", true }, { "id", "object299" } });
+        host.set_property(150, 1, nlohmann::json { { "__QObject*__", true }, { "id", "object0" } });
+        host.set_property(299, 2, nlohmann::json { { "__QObject*__", true }, { "id", "object299" } });
+
+        std::vector<std::string> order;
+        QWebChannel channel(pair.client, [&](QWebChannel *c) {
+            // every object is known and linked when the channel is ready
+            QObject *object = c->object("object150")->property("property1");
+            CHECK(object == c->object("object0"));
+            order.push_back("ready");
+        });
+        channel.set_init_threads(threads);
+        CHECK(channel.init_threads() == threads);
+        pair.run();
+        REQUIRE(channel.initialized());
+        CHECK(order.size() == 1);
+        CHECK(channel.objects().size() == 300);
+
+        const auto objects = describe(channel);
+        if (expected.empty()) {
+            expected = objects;
+            CHECK(objects[0]["properties"]["property0"] == "object299");
+            CHECK(objects[0]["methods"].size() == 3);
+        } else {
+            CHECK(objects == expected);
+        }
+
+        // objects built on other threads work like any other
+        QObject *object = channel.object("object250");
+        int sum = 0;
+        object->connect("signal1", [&](int value) { sum += value; });
+        pair.run();
+        host.emit_signal(250, 1, nlohmann::json::array({ 4 }));
+        pair.run();
+        CHECK(sum == 4);
+
+        int result = 0;
+        object->invoke("method0", 7, [&](int r) { result = r; });
+        pair.run();
+        CHECK(result == 7);
+    }
+}
+
+int main()
+{
+    test_init(false);
+    test_init(true);
+    test_invoke(false);
+    test_invoke(true);
+    test_signals();
+    test_properties(false);
+    test_properties(true);
+    test_tick();
+    test_writer();
+    test_decoder();
+    test_decoded_dispatch();
+    test_callback_table();
+    test_many_requests();
+    test_timer_wheel();
+    test_timeouts();
+    test_futures();
+    test_future_continuations();
+    test_mpsc_queue();
+    test_submissions();
+    test_registry();
+    test_dynamic_objects();
+    test_lazy_objects(false);
+    test_lazy_objects(true);
+    test_parallel_init(false);
+    test_parallel_init(true);
+    test_dispatcher(SignalOrder::PerObject);
+    test_dispatcher(SignalOrder::PerSignal);
+    return Test::result();
+}
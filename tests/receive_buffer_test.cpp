@@ -0,0 +1,118 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#include <webchannelpp/receive_buffer.h>
+
+#include <string>
+
+#include "test_util.h"
+
+using namespace WebChannelPP;
+
+static std::string str(const FrameView &frame)
+{
+    return std::string(frame.data, frame.size);
+}
+
+static void append(ReceiveBuffer &buffer, const std::string &data)
+{
+    buffer.append(data.data(), data.size());
+}
+
+static void test_lines()
+{
+    ReceiveBuffer buffer(16);
+    FrameView frame;
+    CHECK(!buffer.next_line(frame));
+
+    append(buffer, "one\ntwo\n\nthree");
+    REQUIRE(buffer.next_line(frame));
+    CHECK(str(frame) == "one");
+    REQUIRE(buffer.next_line(frame));
+    CHECK(str(frame) == "two");
+    REQUIRE(buffer.next_line(frame));
+    CHECK(str(frame) == "");
+    CHECK(!buffer.next_line(frame));
+    CHECK(buffer.size() == 5);
+
+    // the incomplete frame is completed by later reads
+    append(buffer, " and");
+    CHECK(!buffer.next_line(frame));
+    append(buffer, " four\n");
+    REQUIRE(buffer.next_line(frame));
+    CHECK(str(frame) == "three and four");
+    CHECK(buffer.empty());
+}
+
+static void test_compaction()
+{
+    ReceiveBuffer buffer(8);
+    FrameView frame;
+
+    // consumed bytes are reclaimed before the storage grows
+    append(buffer, "ab\ncd");
+    REQUIRE(buffer.next_line(frame));
+    CHECK(!buffer.next_line(frame));
+    append(buffer, "ef\n");
+    CHECK(buffer.capacity() == 8);
+    REQUIRE(buffer.next_line(frame));
+    CHECK(str(frame) == "cdef");
+
+    // growing keeps the unconsumed bytes
+    append(buffer, "0123");
+    append(buffer, std::string(100, 'x') + "\n");
+    CHECK(buffer.capacity() >= 105);
+    REQUIRE(buffer.next_line(frame));
+    CHECK(str(frame) == "0123" + std::string(100, 'x'));
+}
+
+static void test_prepare_commit()
+{
+    ReceiveBuffer buffer(4);
+    char *space = buffer.prepare(10);
+    std::memcpy(space, "hello\nwor", 9);
+    buffer.commit(9);
+
+    FrameView frame;
+    REQUIRE(buffer.next_line(frame));
+    CHECK(str(frame) == "hello");
+    CHECK(buffer.size() == 3);
+    CHECK(std::string(buffer.data(), buffer.size()) == "wor");
+
+    buffer.consume(3);
+    CHECK(buffer.empty());
+}
+
+static void test_many_frames()
+{
+    ReceiveBuffer buffer;
+    std::string data;
+    for (int i = 0; i < 1000; ++i) {
+        data += std::to_string(i) + "\n";
+    }
+
+    // delivered in chunks that split frames at every possible position
+    int next = 0;
+    for (std::size_t pos = 0; pos < data.size(); pos += 7) {
+        append(buffer, data.substr(pos, 7));
+        FrameView frame;
+        while (buffer.next_line(frame)) {
+            CHECK(str(frame) == std::to_string(next));
+            ++next;
+        }
+    }
+    CHECK(next == 1000);
+    CHECK(buffer.empty());
+}
+
+int main()
+{
+    test_lines();
+    test_compaction();
+    test_prepare_commit();
+    test_many_frames();
+    return Test::result();
+}
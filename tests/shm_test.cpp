@@ -0,0 +1,227 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/shm_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "test_util.h"
+
+using namespace WebChannelPP;
+
+static std::string segment_name(const char *test)
+{
+    return "/webchannelpp-" + std::string(test) + "-" + std::to_string(getpid());
+}
+
+static void test_channel()
+{
+    ShmTransport hostTransport(segment_name("channel"), ShmRole::Host);
+    ShmTransport clientTransport(segment_name("channel"), ShmRole::Client);
+
+    MockHostConfig config;
+    config.objects = 2;
+    MockHost host(hostTransport, config);
+    std::thread hostThread([&]() { hostTransport.run(); });
+
+    std::string result;
+    int value = -1;
+    QWebChannel channel(clientTransport, [&](QWebChannel *channel) {
+        QObject *object = channel->object("object1");
+        object->invoke("method0", std::string(100000, 'q'), [&](const std::string &r) { result = r; });
+        object->invoke("method1", 42, [&](int r) { value = r; });
+    });
+
+    for (int i = 0; i < 1000 && value < 0; ++i) {
+        clientTransport.run_once();
+    }
+
+    hostTransport.stop();
+    hostThread.join();
+
+    CHECK(channel.objects().size() == 2);
+    CHECK(result == std::string(100000, 'q'));
+    CHECK(value == 42);
+}
+
+static void test_send_from_handler()
+{
+    ShmTransport host(segment_name("reentrant"), ShmRole::Host, 4096);
+    ShmTransport client(segment_name("reentrant"), ShmRole::Client);
+
+    const auto payload = [](char c) { return "\"" + std::string(500, c) + "\""; };
+
+    std::atomic<int> hostReceived { 0 };
+    host.register_serialized_message_handler([&](const char *, std::size_t) { ++hostReceived; });
+    std::thread hostThread([&]() {
+        for (int i = 0; i < 20; ++i) {
+            host.send_serialized(payload(char('a' + i)));
+        }
+        host.run();
+    });
+
+    // the ring is too small for the replies, so sending drains incoming messages into the backlog
+    int received = 0;
+    bool intact = true;
+    client.register_serialized_message_handler([&](const char *data, std::size_t size) {
+        const std::string copy(data, size);
+        for (int i = 0; i < 20; ++i) {
+            client.send_serialized(payload('x'));
+        }
+        intact = intact && std::string(data, size) == copy && copy == payload(char('a' + received));
+        ++received;
+    });
+
+    for (int i = 0; i < 1000 && received < 20; ++i) {
+        client.run_once();
+    }
+    for (int i = 0; i < 1000 && hostReceived < 400; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    host.stop();
+    hostThread.join();
+
+    CHECK(received == 20);
+    CHECK(intact);
+    CHECK(hostReceived == 400);
+}
+
+static void test_stop_before_run()
+{
+    ShmTransport host(segment_name("stop"), ShmRole::Host);
+
+    // a stop() that comes before run() ends the next run() right away ...
+    host.stop();
+    host.run();
+
+    // ... and only that one
+    std::atomic<bool> running { true };
+    std::thread thread([&]() { host.run(); running = false; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(running);
+    host.stop();
+    thread.join();
+    CHECK(!running);
+}
+
+static void test_invalid_records()
+{
+    detail::ShmRingHeader header {};
+    char data[64];
+    detail::ShmRing ring(&header, data, sizeof(data));
+    CHECK(ring.max_record() == sizeof(data) - sizeof(std::uint32_t));
+
+    std::string scratch;
+    CHECK(ring.try_write("hello", 5));
+    CHECK(ring.try_read(scratch));
+    CHECK(scratch == "hello");
+
+    // a length prefix larger than what was published is not trusted
+    CHECK(ring.try_write("hello", 5));
+    const std::uint32_t bogus = 0xffffff00;
+    std::memcpy(data + (header.tail % sizeof(data)), &bogus, sizeof(bogus));
+    CHECK(!ring.try_read(scratch));
+    CHECK(ring.corrupt());
+    CHECK(ring.empty());
+    CHECK(scratch == "hello");
+
+    // nor is a head that is further ahead than the ring is large
+    detail::ShmRingHeader header2 {};
+    detail::ShmRing ring2(&header2, data, sizeof(data));
+    header2.head = 1000;
+    CHECK(!ring2.try_read(scratch));
+    CHECK(ring2.corrupt());
+
+    // records larger than the limit are rejected before anything is allocated
+    detail::ShmRingHeader header3 {};
+    detail::ShmRing ring3(&header3, data, sizeof(data));
+    ring3.set_max_record(4);
+    CHECK(ring3.max_record() == 4);
+    ring3.set_max_record(1000);
+    CHECK(ring3.max_record() == sizeof(data) - sizeof(std::uint32_t));
+    ring3.set_max_record(4);
+    CHECK(ring3.try_write("abcd", 4));
+    CHECK(ring3.try_read(scratch));
+    CHECK(ring3.try_write("abcde", 5));
+    CHECK(!ring3.try_read(scratch));
+    CHECK(ring3.corrupt());
+}
+
+static void test_max_message_size()
+{
+    ShmTransport host(segment_name("limit"), ShmRole::Host, 4096);
+    ShmTransport client(segment_name("limit"), ShmRole::Client);
+    host.set_max_message_size(100);
+    CHECK(host.max_message_size() == 100);
+
+    std::vector<std::string> received;
+    host.register_serialized_message_handler([&](const char *data, std::size_t size) {
+        received.emplace_back(data, size);
+    });
+
+    client.send_serialized("\"small\"");
+    client.send_serialized("\"" + std::string(200, 'x') + "\"");
+    client.send_serialized("\"after\"");
+    CHECK(host.poll() == 1);
+    CHECK(host.corrupt());
+    CHECK(!client.corrupt());
+    CHECK(host.run_once(std::chrono::milliseconds(1)) == 0);
+    REQUIRE(received.size() == 1);
+    CHECK(received[0] == "\"small\"");
+}
+
+static void test_stale_segment()
+{
+    const std::string name = segment_name("stale");
+
+    // left behind by a host that crashed, with a size and contents that do not fit
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    REQUIRE(fd >= 0);
+    CHECK(ftruncate(fd, 100) == 0);
+    CHECK(write(fd, "garbage", 7) == 7);
+    close(fd);
+
+    ShmTransport host(name, ShmRole::Host, 4096);
+    ShmTransport client(name, ShmRole::Client);
+
+    std::string received;
+    host.register_serialized_message_handler([&](const char *data, std::size_t size) {
+        received.assign(data, size);
+    });
+    client.send_serialized("42");
+    CHECK(host.poll() == 1);
+    CHECK(received == "42");
+
+    // a second host does not truncate the segment the first one uses
+    {
+        ShmTransport second(name, ShmRole::Host, 4096);
+    }
+    client.send_serialized("43");
+    CHECK(host.poll() == 1);
+    CHECK(received == "43");
+}
+
+int main()
+{
+    test_channel();
+    test_send_from_handler();
+    test_stop_before_run();
+    test_invalid_records();
+    test_max_message_size();
+    test_stale_segment();
+    return Test::result();
+}
@@ -0,0 +1,29 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// Makes Boost.Asio available as standalone asio, for building the tests where only Boost is installed
+
+#ifndef WEBCHANNELPP_BOOST_ASIO_HPP
+#define WEBCHANNELPP_BOOST_ASIO_HPP
+
+#include <boost/asio.hpp>
+
+namespace asio
+{
+using namespace boost::asio;
+using error_code = boost::system::error_code;
+namespace error = boost::asio::error;
+namespace ip = boost::asio::ip;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+namespace local = boost::asio::local;
+#endif
+}
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+#define ASIO_HAS_LOCAL_SOCKETS 1
+#endif
+
+#endif // WEBCHANNELPP_BOOST_ASIO_HPP
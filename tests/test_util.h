@@ -0,0 +1,58 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <iostream>
+
+namespace WebChannelPP
+{
+namespace Test
+{
+
+inline int &failures()
+{
+    static int count = 0;
+    return count;
+}
+
+/// @brief Returns the exit code of a test executable
+inline int result()
+{
+    if (failures() > 0) {
+        std::cerr << failures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/// Exit code that makes ctest report a test as skipped
+constexpr int skipped = 77;
+
+}
+}
+
+/// @brief Records a failure if @p cond is false and carries on
+#define CHECK(cond)                                                                          \
+    do {                                                                                     \
+        if (!(cond)) {                                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            ++WebChannelPP::Test::failures();                                                \
+        }                                                                                    \
+    } while (0)
+
+/// @brief Like CHECK, but returns from the calling function on failure
+#define REQUIRE(cond)                                                                        \
+    do {                                                                                     \
+        if (!(cond)) {                                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            ++WebChannelPP::Test::failures();                                                \
+            return;                                                                          \
+        }                                                                                    \
+    } while (0)
+
+#endif // TEST_UTIL_H
@@ -0,0 +1,133 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/uring_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "test_util.h"
+
+using namespace WebChannelPP;
+
+struct SocketPair
+{
+    int fds[2] = { -1, -1 };
+
+    SocketPair() { socketpair(AF_UNIX, SOCK_STREAM, 0, fds); }
+    ~SocketPair()
+    {
+        close(fds[0]);
+        close(fds[1]);
+    }
+};
+
+template<class Transport>
+static void test_channel(UringLoop &loop)
+{
+    SocketPair sockets;
+    Transport hostTransport(loop, sockets.fds[0]);
+    Transport clientTransport(loop, sockets.fds[1]);
+
+    MockHostConfig config;
+    config.objects = 3;
+    MockHost host(hostTransport, config);
+
+    // larger than a receive buffer, so it arrives in several completions
+    const std::string argument(100000, 'u');
+    std::string result;
+    QWebChannel channel(clientTransport, [&](QWebChannel *channel) {
+        channel->object("object2")->invoke("method0", argument, [&](const std::string &r) {
+            result = r;
+            loop.stop();
+        });
+    });
+    loop.run();
+
+    CHECK(channel.objects().size() == 3);
+    CHECK(result == argument);
+}
+
+static void test_many_connections()
+{
+    // far fewer submission slots than connections, so submitting has to wait for free ones
+    UringLoop loop(4, 64, 4096);
+    const int connections = 50;
+    const int messages = 10;
+
+    std::vector<std::unique_ptr<SocketPair>> sockets;
+    std::vector<std::unique_ptr<LengthPrefixedUringTransport>> clients, echoes;
+    int received = 0;
+    for (int i = 0; i < connections; ++i) {
+        sockets.emplace_back(new SocketPair);
+        clients.emplace_back(new LengthPrefixedUringTransport(loop, sockets.back()->fds[0]));
+        echoes.emplace_back(new LengthPrefixedUringTransport(loop, sockets.back()->fds[1]));
+
+        LengthPrefixedUringTransport *echo = echoes.back().get();
+        echo->register_message_handler([echo](const nlohmann::json &message) { echo->send(message); });
+        clients.back()->register_message_handler([&](const nlohmann::json &) {
+            if (++received == connections * messages) {
+                loop.stop();
+            }
+        });
+    }
+
+    for (int n = 0; n < messages; ++n) {
+        for (auto &client : clients) {
+            client->send(nlohmann::json { { "n", n } });
+        }
+    }
+    loop.run();
+    CHECK(received == connections * messages);
+
+    // a stop() before run() is not lost
+    loop.stop();
+    loop.run();
+}
+
+static void test_oversized_frame(UringLoop &loop)
+{
+    SocketPair sockets;
+    std::unique_ptr<LengthPrefixedUringTransport> transport(new LengthPrefixedUringTransport(loop, sockets.fds[0]));
+    transport->set_max_frame_size(100);
+
+    const char header[] = { '\x7f', 0, 0, 0 };
+    REQUIRE(write(sockets.fds[1], header, sizeof(header)) == sizeof(header));
+
+    // the transport shuts the socket down, which the peer sees as end of stream
+    bool closed = false;
+    for (int i = 0; i < 100 && !closed; ++i) {
+        loop.run_once(false);
+        char c;
+        closed = recv(sockets.fds[1], &c, 1, MSG_DONTWAIT) == 0;
+        usleep(1000);
+    }
+    CHECK(closed);
+}
+
+int main()
+{
+    std::unique_ptr<UringLoop> loop;
+    try {
+        loop.reset(new UringLoop);
+    } catch (const std::system_error &e) {
+        std::cerr << "io_uring not available: " << e.what() << std::endl;
+        return Test::skipped;
+    }
+
+    test_channel<UringTransport>(*loop);
+    test_channel<LengthPrefixedUringTransport>(*loop);
+    test_many_connections();
+    test_oversized_frame(*loop);
+    return Test::result();
+}
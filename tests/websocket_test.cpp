@@ -0,0 +1,325 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+// WebSocketTransport against a minimal blocking WebSocket server, which runs the mock host or
+// sends hand-made frames
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/websocket_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_util.h"
+
+using namespace WebChannelPP;
+
+// server side of a single connection; all calls block
+class WebSocketServer : public Transport
+{
+    asio::ip::tcp::socket &m_socket;
+    std::string m_pending;
+    message_handler m_handler;
+
+public:
+    explicit WebSocketServer(asio::ip::tcp::socket &socket) : m_socket(socket) {}
+
+    void send(const nlohmann::json &message) override { write_frame(0x1, message.dump()); }
+    void register_message_handler(message_handler handler) override { m_handler = std::move(handler); }
+
+    bool handshake()
+    {
+        asio::error_code err;
+        const std::size_t end = asio::read_until(m_socket, asio::dynamic_buffer(m_pending), "\r\n\r\n", err);
+        if (err) {
+            return false;
+        }
+        const std::string request = m_pending.substr(0, end);
+        m_pending.erase(0, end);
+
+        static const std::string keyHeader = "Sec-WebSocket-Key: ";
+        const std::size_t pos = request.find(keyHeader) + keyHeader.size();
+        const std::string key = request.substr(pos, request.find("\r\n", pos) - pos);
+        const auto digest = detail::sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+
+        const std::string response = "HTTP/1.1 101 Switching Protocols\r\n"
+                                     "Upgrade: websocket\r\n"
+                                     "Connection: Upgrade\r\n"
+                                     "Sec-WebSocket-Accept: " + detail::base64_encode(digest.data(), digest.size()) + "\r\n"
+                                     "\r\n";
+        asio::write(m_socket, asio::buffer(response), err);
+        return !err;
+    }
+
+    /// @brief Writes an unmasked frame, with the length field in its shortest form unless @p length is given
+    void write_frame(int opcode, const std::string &payload, bool fin = true, std::uint64_t length = ~0ull)
+    {
+        if (length == ~0ull) {
+            length = payload.size();
+        }
+
+        std::string frame(1, char((fin ? 0x80 : 0) | opcode));
+        if (length < 126) {
+            frame.push_back(char(length));
+        } else if (length <= 0xFFFF) {
+            frame.push_back(char(126));
+            frame.push_back(char(length >> 8));
+            frame.push_back(char(length));
+        } else {
+            frame.push_back(char(127));
+            for (int i = 7; i >= 0; --i) {
+                frame.push_back(char(length >> (i * 8)));
+            }
+        }
+        frame += payload;
+
+        asio::error_code err;
+        asio::write(m_socket, asio::buffer(frame), err);
+    }
+
+    /// @return false on a closed connection
+    bool read_frame(int &opcode, std::string &payload)
+    {
+        unsigned char header[14];
+        if (!read_exact(header, 2)) {
+            return false;
+        }
+        opcode = header[0] & 0x0F;
+        std::uint64_t length = header[1] & 0x7F;
+        const std::size_t lengthBytes = length == 126 ? 2 : length == 127 ? 8 : 0;
+        if (!read_exact(header + 2, lengthBytes + 4)) {
+            return false;
+        }
+        if (lengthBytes > 0) {
+            length = 0;
+            for (std::size_t i = 0; i < lengthBytes; ++i) {
+                length = (length << 8) | header[2 + i];
+            }
+        }
+
+        payload.resize(length);
+        if (!read_exact(&payload[0], length)) {
+            return false;
+        }
+        for (std::size_t i = 0; i < length; ++i) {
+            payload[i] ^= char(header[2 + lengthBytes + i % 4]);
+        }
+        return true;
+    }
+
+    /// @brief Dispatches text frames to the message handler until the client closes
+    /// @return The status code of the client's close frame, or -1
+    int serve()
+    {
+        int opcode;
+        std::string payload;
+        while (read_frame(opcode, payload)) {
+            if (opcode == 0x1 && m_handler) {
+                m_handler(nlohmann::json::parse(payload));
+            } else if (opcode == 0x8) {
+                write_frame(0x8, payload.substr(0, 2));
+                asio::error_code err;
+                m_socket.shutdown(asio::ip::tcp::socket::shutdown_both, err);
+                return payload.size() >= 2 ? (std::uint8_t(payload[0]) << 8) | std::uint8_t(payload[1]) : -1;
+            }
+        }
+        return -1;
+    }
+
+private:
+    bool read_exact(void *data, std::size_t size)
+    {
+        char *out = static_cast<char*>(data);
+        const std::size_t buffered = std::min(size, m_pending.size());
+        std::memcpy(out, m_pending.data(), buffered);
+        m_pending.erase(0, buffered);
+
+        asio::error_code err;
+        asio::read(m_socket, asio::buffer(out + buffered, size - buffered), err);
+        return !err;
+    }
+};
+
+// runs @p server on its own thread, connected to a WebSocketTransport driven by the caller
+struct Fixture
+{
+    asio::io_context serverIo;
+    asio::io_context clientIo;
+    asio::ip::tcp::acceptor acceptor;
+    asio::ip::tcp::socket serverSocket;
+    asio::ip::tcp::socket clientSocket;
+    std::thread thread;
+    std::atomic<int> closeCode { 0 };
+
+    explicit Fixture(std::function<int(WebSocketServer &)> server)
+        : acceptor(serverIo, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0)),
+          serverSocket(serverIo), clientSocket(clientIo)
+    {
+        clientSocket.connect(acceptor.local_endpoint());
+        acceptor.accept(serverSocket);
+
+        thread = std::thread([this, server]() {
+            WebSocketServer ws(serverSocket);
+            closeCode = ws.handshake() ? server(ws) : -2;
+        });
+    }
+
+    ~Fixture()
+    {
+        asio::error_code err;
+        clientSocket.close(err);
+        thread.join();
+    }
+
+    /// @brief Runs the client until @p done returns true
+    template<class Predicate>
+    bool run_until(Predicate done)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!done() && std::chrono::steady_clock::now() < deadline) {
+            clientIo.run_for(std::chrono::milliseconds(10));
+            clientIo.restart();
+        }
+        return done();
+    }
+};
+
+static void test_channel()
+{
+    Fixture fixture([](WebSocketServer &server) {
+        MockHostConfig config;
+        config.objects = 2;
+        MockHost host(server, config);
+        return server.serve();
+    });
+
+    WebSocketTransport transport(fixture.clientSocket, "localhost");
+    std::unique_ptr<QWebChannel> channel;
+    int result = -1;
+    int changes = 0;
+
+    // the channel lives on the strand of the transport
+    transport.post([&]() {
+        channel.reset(new QWebChannel(transport, [&](QWebChannel *channel) {
+            QObject *object = channel->object("object1");
+            object->connect("property0Changed", [&](int) { ++changes; });
+            object->invoke("method0", std::string(70000, 'y'), [&](const std::string &r) { result = int(r.size()); });
+            object->set_property("property0", 3);
+        }));
+    });
+
+    CHECK(fixture.run_until([&]() { return result >= 0 && changes > 0; }));
+    CHECK(transport.is_open());
+    CHECK(result == 70000);
+    CHECK(int(channel->object("object1")->property("property0")) == 3);
+
+    transport.post([&]() { transport.close(); });
+    CHECK(fixture.run_until([&]() { return fixture.closeCode != 0; }));
+    CHECK(fixture.closeCode == 1000);
+}
+
+static void test_fragments_and_ping()
+{
+    Fixture fixture([](WebSocketServer &server) {
+        server.write_frame(0x9, "ping");
+        server.write_frame(0x1, "{\"a\":", false);
+        server.write_frame(0x0, "\"fragmented\"", false);
+        server.write_frame(0x0, "}", true);
+
+        int opcode;
+        std::string payload;
+        if (!server.read_frame(opcode, payload) || opcode != 0xA || payload != "ping") {
+            return -3;
+        }
+        return server.serve();
+    });
+
+    WebSocketTransport transport(fixture.clientSocket, "localhost");
+    nlohmann::json received;
+    transport.register_message_handler([&](const nlohmann::json &message) { received = message; });
+
+    CHECK(fixture.run_until([&]() { return !received.is_null(); }));
+    CHECK(received == nlohmann::json({ { "a", "fragmented" } }));
+
+    transport.post([&]() { transport.close(); });
+    CHECK(fixture.run_until([&]() { return fixture.closeCode != 0; }));
+    CHECK(fixture.closeCode == 1000);
+}
+
+static void test_oversized_frame()
+{
+    // a 64-bit length of 2^62, without any payload behind it
+    Fixture fixture([](WebSocketServer &server) {
+        server.write_frame(0x2, std::string(), true, 1ull << 62);
+        return server.serve();
+    });
+
+    WebSocketTransport transport(fixture.clientSocket, "localhost");
+    CHECK(fixture.run_until([&]() { return fixture.closeCode != 0; }));
+    CHECK(fixture.closeCode == WebSocketTransport::message_too_big);
+}
+
+static void test_endless_fragments()
+{
+    // every fragment is small, but the message keeps growing
+    Fixture fixture([](WebSocketServer &server) {
+        server.write_frame(0x1, std::string(600, ' '), false);
+        for (int i = 0; i < 100; ++i) {
+            server.write_frame(0x0, std::string(600, ' '), false);
+        }
+        return server.serve();
+    });
+
+    WebSocketTransport transport(fixture.clientSocket, "localhost");
+    transport.set_max_frame_size(1000);
+    transport.set_max_message_size(2000);
+    int received = 0;
+    transport.register_message_handler([&](const nlohmann::json &) { ++received; });
+
+    CHECK(fixture.run_until([&]() { return fixture.closeCode != 0; }));
+    CHECK(fixture.closeCode == WebSocketTransport::message_too_big);
+    CHECK(received == 0);
+}
+
+static void test_invalid_control_frames()
+{
+    // a fragmented ping, and a ping whose payload is too long for a control frame
+    const std::vector<std::function<void(WebSocketServer &)>> frames = {
+        [](WebSocketServer &server) { server.write_frame(0x9, "ping", false); },
+        [](WebSocketServer &server) { server.write_frame(0x9, std::string(126, 'p')); },
+        [](WebSocketServer &server) { server.write_frame(0x8, std::string(200, 'c')); },
+    };
+
+    for (const auto &frame : frames) {
+        Fixture fixture([&frame](WebSocketServer &server) {
+            frame(server);
+            server.write_frame(0x1, "1");
+            return server.serve();
+        });
+
+        WebSocketTransport transport(fixture.clientSocket, "localhost");
+        int received = 0;
+        transport.register_message_handler([&](const nlohmann::json &) { ++received; });
+
+        CHECK(fixture.run_until([&]() { return fixture.closeCode != 0; }));
+        CHECK(fixture.closeCode == WebSocketTransport::protocol_error);
+        CHECK(received == 0);
+    }
+}
+
+int main()
+{
+    test_channel();
+    test_fragments_and_ping();
+    test_oversized_frame();
+    test_endless_fragments();
+    test_invalid_control_frames();
+    return Test::result();
+}
@@ -0,0 +1,153 @@
+/*
+ * This file is part of WebChannel++.
+ * Copyright (C) 2018, Menlo Systems GmbH
+ * License: Dual-licensed under LGPLv3 and GPLv2+
+ */
+
+#include <webchannelpp/qwebchannelpp.h>
+#include <webchannelpp/asio_transport.h>
+#include <webchannelpp/mock_host.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test_util.h"
+
+using namespace WebChannelPP;
+
+static const WireFormat formats[] = { WireFormat::Json, WireFormat::Cbor, WireFormat::MessagePack, WireFormat::Ubjson };
+
+static std::vector<nlohmann::json> samples()
+{
+    return {
+        nlohmann::json::object(),
+        { { "type", 6 }, { "object", "object0" }, { "method", 12 }, { "args", { 1, "two", 3.5, nullptr, true } }, { "id", 7 } },
+        { { "text", "with\nnewline and \"quotes\" and \xc3\xa4" } },
+        { { "nested", { { "array", nlohmann::json::array({ nlohmann::json::array(), { { "a", -1 } } }) } } } },
+        { { "large", std::string(100000, 'x') }, { "big", 1ull << 40 } },
+    };
+}
+
+static void test_round_trip()
+{
+    for (WireFormat format : formats) {
+        for (const auto &value : samples()) {
+            std::string encoded;
+            encode_message(value, format, encoded);
+            CHECK(decode_message<nlohmann::json>(encoded.data(), encoded.size(), format) == value);
+        }
+    }
+}
+
+static void test_encoder()
+{
+    // the encoder appends, and produces the same bytes as encode_message()
+    for (WireFormat format : formats) {
+        BasicMessageEncoder<nlohmann::json> encoder(format);
+        CHECK(encoder.format() == format);
+
+        std::string all;
+        std::string expected;
+        for (const auto &value : samples()) {
+            std::string single;
+            encode_message(value, format, single);
+            expected += single;
+            encoder.encode(value, all);
+        }
+        CHECK(all == expected);
+    }
+
+    // a copy writes into its own output, not into that of the original
+    BasicMessageEncoder<nlohmann::json> original;
+    BasicMessageEncoder<nlohmann::json> copy(original);
+    std::string first;
+    std::string second;
+    original.encode({ { "a", 1 } }, first);
+    copy.encode({ { "b", 2 } }, second);
+    CHECK(first == "{\"a\":1}");
+    CHECK(second == "{\"b\":2}");
+}
+
+static void test_malformed()
+{
+    // truncated messages
+    for (WireFormat format : formats) {
+        std::string encoded;
+        encode_message(nlohmann::json { { "text", "abc" } }, format, encoded);
+        encoded.pop_back();
+
+        bool thrown = false;
+        try {
+            decode_message<nlohmann::json>(encoded.data(), encoded.size(), format);
+        } catch (const nlohmann::json::exception &) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+}
+
+template<class Transport>
+struct Connection
+{
+    asio::ip::tcp::socket clientSocket;
+    asio::ip::tcp::socket hostSocket;
+    std::unique_ptr<Transport> client;
+    std::unique_ptr<Transport> host;
+
+    explicit Connection(asio::io_context &io)
+        : clientSocket(io), hostSocket(io)
+    {
+        asio::ip::tcp::acceptor acceptor(io, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+        clientSocket.connect(acceptor.local_endpoint());
+        acceptor.accept(hostSocket);
+        client.reset(new Transport(clientSocket));
+        host.reset(new Transport(hostSocket));
+    }
+};
+
+static void test_framing_check()
+{
+    asio::io_context io;
+    Connection<AsioTransport> connection(io);
+    CHECK(!connection.client->set_wire_format(WireFormat::Cbor));
+    CHECK(connection.client->wire_format() == WireFormat::Json);
+    CHECK(connection.client->accepts_serialized());
+}
+
+static void test_channel(WireFormat format)
+{
+    asio::io_context io;
+    Connection<LengthPrefixedAsioTransport> connection(io);
+    REQUIRE(connection.client->set_wire_format(format));
+    REQUIRE(connection.host->set_wire_format(format));
+    CHECK(!connection.client->accepts_serialized());
+
+    MockHostConfig config;
+    config.objects = 2;
+    MockHost host(*connection.host, config);
+
+    int result = -1;
+    QWebChannel channel(*connection.client, [&](QWebChannel *channel) {
+        channel->object("object1")->invoke("method0", "binary\n\xff", [&](const std::string &r) {
+            result = r == "binary\n\xff" ? 1 : 0;
+        });
+    });
+
+    while (result < 0 && io.run_one_for(std::chrono::seconds(5)) > 0) {
+    }
+    CHECK(result == 1);
+    CHECK(host.stats().invokes == 1);
+}
+
+int main()
+{
+    test_round_trip();
+    test_encoder();
+    test_malformed();
+    test_framing_check();
+    test_channel(WireFormat::Cbor);
+    test_channel(WireFormat::MessagePack);
+    test_channel(WireFormat::Ubjson);
+    return Test::result();
+}